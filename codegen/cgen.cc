@@ -1,7 +1,10 @@
 #include "cgen.h"
 #include "cgen_supp.h"
 #include "handle_flags.h"
-#include <unordered_set>
+#include "symflags.h"
+#include "timing.h"
+#include "peephole.h"
+#include <climits>
 #include <map>
 
 static Symbol
@@ -34,45 +37,68 @@ static Symbol
     type_name,
     val;
 
+// basic_names, interned; indexed by BasicName.
+static Symbol basic_symbols[N_BASIC_NAMES];
+
 static void initialize_constants(void)
 {
-  arg = idtable.add_string("arg");
-  arg2 = idtable.add_string("arg2");
-  Bool = idtable.add_string("Bool");
-  concat = idtable.add_string("concat");
-  cool_abort = idtable.add_string("abort");
-  ::copy = idtable.add_string("copy");
-  Int = idtable.add_string("Int");
-  in_int = idtable.add_string("in_int");
-  in_string = idtable.add_string("in_string");
-  IO = idtable.add_string("IO");
-  length = idtable.add_string("length");
+  // The basic class names are interned once, and the constants below
+  // that name one of them share its symbol.
+  for (int i = 0; i < N_BASIC_NAMES; i++)
+    basic_symbols[i] = idtable.add_string((char *)basic_names[i]);
+
+  arg = basic_symbols[BN_arg];
+  arg2 = basic_symbols[BN_arg2];
+  Bool = basic_symbols[BN_Bool];
+  concat = basic_symbols[BN_concat];
+  cool_abort = basic_symbols[BN_abort];
+  ::copy = basic_symbols[BN_copy];
+  Int = basic_symbols[BN_Int];
+  in_int = basic_symbols[BN_in_int];
+  in_string = basic_symbols[BN_in_string];
+  IO = basic_symbols[BN_IO];
+  length = basic_symbols[BN_length];
   Main = idtable.add_string("Main");
   main_meth = idtable.add_string("main");
   //   _no_class is a symbol that can't be the name of any
   //   user-defined class.
-  No_class = idtable.add_string("_no_class");
+  No_class = basic_symbols[BN_no_class];
   No_type = idtable.add_string("_no_type");
-  Object = idtable.add_string("Object");
-  out_int = idtable.add_string("out_int");
-  out_string = idtable.add_string("out_string");
-  prim_slot = idtable.add_string("_prim_slot");
+  Object = basic_symbols[BN_Object];
+  out_int = basic_symbols[BN_out_int];
+  out_string = basic_symbols[BN_out_string];
+  prim_slot = basic_symbols[BN_prim_slot];
   self = idtable.add_string("self");
-  SELF_TYPE = idtable.add_string("SELF_TYPE");
-  Str = idtable.add_string("String");
-  str_field = idtable.add_string("_str_field");
-  substr = idtable.add_string("substr");
-  type_name = idtable.add_string("type_name");
-  val = idtable.add_string("_val");
+  SELF_TYPE = basic_symbols[BN_SELF_TYPE];
+  Str = basic_symbols[BN_String];
+  str_field = basic_symbols[BN_str_field];
+  substr = basic_symbols[BN_substr];
+  type_name = basic_symbols[BN_type_name];
+  val = basic_symbols[BN_val];
 }
 
-static const std::unordered_set<std::string> basic_classes = {"Object", "IO", "Int", "Bool", "String", "SELF_TYPE"};
+static SymbolFlags symbol_flags;
+
+static void initialize_symbol_flags(void)
+{
+  symbol_flags.set(Object, SYM_BASIC_CLASS);
+  symbol_flags.set(IO, SYM_BASIC_CLASS);
+  symbol_flags.set(Int, SYM_BASIC_CLASS | SYM_UNINHERITABLE | SYM_BASIC_VALUE);
+  symbol_flags.set(Bool, SYM_BASIC_CLASS | SYM_UNINHERITABLE | SYM_BASIC_VALUE);
+  symbol_flags.set(Str, SYM_BASIC_CLASS | SYM_UNINHERITABLE | SYM_BASIC_VALUE);
+  symbol_flags.set(SELF_TYPE, SYM_BASIC_CLASS | SYM_UNINHERITABLE | SYM_SELF_TYPE | SYM_RESERVED);
+  symbol_flags.set(self, SYM_RESERVED);
+}
 
 static const char *gc_init_names[] =
     {"_NoGC_Init", "_GenGC_Init", "_ScnGC_Init"};
 static const char *gc_collect_names[] =
     {"_NoGC_Collect", "_GenGC_Collect", "_ScnGC_Collect"};
 
+// Expression temporaries, handed out from the back.  Nothing else in
+// the generated code uses $t3-$t9.
+static Register const temp_registers[] = {"$t9", "$t8", "$t7", "$t6", "$t5", "$t4", "$t3"};
+
 BoolConst falsebool(FALSE);
 BoolConst truebool(TRUE);
 int labelCounter = 0;
@@ -80,131 +106,144 @@ int labelCounter = 0;
 void program_class::cgen(ostream &os)
 {
   initialize_constants();
+  initialize_symbol_flags();
   CgenClassTable *codegen_classtable = new CgenClassTable(classes, os);
 }
 
-static std::string get_label_ref(int l)
+//
+// The assembly name of a constant, exactly as its code_ref writes it.
+//
+template <class Constant>
+static std::string constant_ref(Constant &c)
+{
+  std::ostringstream ss;
+  c.code_ref(ss);
+  return ss.str();
+}
+
+static Instr &emit_label_instr(Opcode op, int label, MipsCode &s)
+{
+  Instr &instr = s.append(Instr(op));
+  instr.label = label;
+  return instr;
+}
+
+static void emit_symbol_instr(Opcode op, Register dest, const std::string &sym, MipsCode &s)
+{
+  s.append(Instr(op, dest)).sym = sym;
+}
+
+static void emit_load(const char *dest_reg, int offset, const char *source_reg, MipsCode &s)
 {
-  std::stringstream ss;
-  ss << l;
-  std::string lbl = "label" + ss.str();
-  return lbl;
+  s.append(Instr(OP_LW, dest_reg, source_reg, NULL, offset * WORD_SIZE));
 }
 
-static void emit_load(const char *dest_reg, int offset, const char *source_reg, ostream &s)
+static void emit_store(const char *source_reg, int offset, const char *dest_reg, MipsCode &s)
 {
-  s << LW << dest_reg << " " << offset * WORD_SIZE << "(" << source_reg << ")"
-    << std::endl;
+  s.append(Instr(OP_SW, source_reg, dest_reg, NULL, offset * WORD_SIZE));
 }
 
-static void emit_store(const char *source_reg, int offset, const char *dest_reg, ostream &s)
+static void emit_load_imm(const char *dest_reg, int val, MipsCode &s)
 {
-  s << SW << source_reg << " " << offset * WORD_SIZE << "(" << dest_reg << ")"
-    << std::endl;
+  s.append(Instr(OP_LI, dest_reg, NULL, NULL, val));
 }
 
-static void emit_load_imm(const char *dest_reg, int val, ostream &s)
+static void emit_load_address(const char *dest_reg, const std::string &address, MipsCode &s)
 {
-  s << LI << dest_reg << " " << val << std::endl;
+  emit_symbol_instr(OP_LA, dest_reg, address, s);
 }
 
-static void emit_load_address(const char *dest_reg, const char *address, ostream &s)
+static void emit_load_bool(const char *dest, const BoolConst &b, MipsCode &s)
 {
-  s << LA << dest_reg << " " << address << std::endl;
+  emit_load_address(dest, constant_ref(b), s);
 }
 
-static void emit_partial_load_address(const char *dest_reg, ostream &s)
+static void emit_load_string(const char *dest, StringEntry *str, MipsCode &s)
 {
-  s << LA << dest_reg << " ";
+  emit_load_address(dest, constant_ref(*str), s);
 }
 
-static void emit_load_bool(const char *dest, const BoolConst &b, ostream &s)
+static void emit_load_int(const char *dest, IntEntry *i, MipsCode &s)
 {
-  emit_partial_load_address(dest, s);
-  b.code_ref(s);
-  s << std::endl;
+  emit_load_address(dest, constant_ref(*i), s);
 }
 
-static void emit_load_string(const char *dest, StringEntry *str, ostream &s)
+static void emit_move(const char *dest_reg, const char *source_reg, MipsCode &s)
 {
-  emit_partial_load_address(dest, s);
-  str->code_ref(s);
-  s << std::endl;
+  s.append(Instr(OP_MOVE, dest_reg, source_reg));
 }
 
-static void emit_load_int(const char *dest, IntEntry *i, ostream &s)
+static void emit_neg(const char *dest, const char *src1, MipsCode &s)
 {
-  emit_partial_load_address(dest, s);
-  i->code_ref(s);
-  s << std::endl;
+  s.append(Instr(OP_NEG, dest, src1));
 }
 
-static void emit_move(const char *dest_reg, const char *source_reg, ostream &s)
+static void emit_add(const char *dest, const char *src1, const char *src2, MipsCode &s)
 {
-  s << MOVE << dest_reg << " " << source_reg << std::endl;
+  s.append(Instr(OP_ADD, dest, src1, src2));
 }
 
-static void emit_neg(const char *dest, const char *src1, ostream &s)
+static void emit_addu(const char *dest, const char *src1, const char *src2, MipsCode &s)
 {
-  s << NEG << dest << " " << src1 << std::endl;
+  s.append(Instr(OP_ADDU, dest, src1, src2));
 }
 
-static void emit_add(const char *dest, const char *src1, const char *src2, ostream &s)
+static void emit_addiu(const char *dest, const char *src1, int imm, MipsCode &s)
 {
-  s << ADD << dest << " " << src1 << " " << src2 << std::endl;
+  s.append(Instr(OP_ADDIU, dest, src1, NULL, imm));
 }
 
-static void emit_addu(const char *dest, const char *src1, const char *src2, ostream &s)
+static void emit_div(const char *dest, const char *src1, const char *src2, MipsCode &s)
 {
-  s << ADDU << dest << " " << src1 << " " << src2 << std::endl;
+  s.append(Instr(OP_DIV, dest, src1, src2));
 }
 
-static void emit_addiu(const char *dest, const char *src1, int imm, ostream &s)
+static void emit_mul(const char *dest, const char *src1, const char *src2, MipsCode &s)
 {
-  s << ADDIU << dest << " " << src1 << " " << imm << std::endl;
+  s.append(Instr(OP_MUL, dest, src1, src2));
 }
 
-static void emit_div(const char *dest, const char *src1, const char *src2, ostream &s)
+static void emit_sub(const char *dest, const char *src1, const char *src2, MipsCode &s)
 {
-  s << DIV << dest << " " << src1 << " " << src2 << std::endl;
+  s.append(Instr(OP_SUB, dest, src1, src2));
 }
 
-static void emit_mul(const char *dest, const char *src1, const char *src2, ostream &s)
+static void emit_sll(const char *dest, const char *src1, int num, MipsCode &s)
 {
-  s << MUL << dest << " " << src1 << " " << src2 << std::endl;
+  s.append(Instr(OP_SLL, dest, src1, NULL, num));
 }
 
-static void emit_sub(const char *dest, const char *src1, const char *src2, ostream &s)
+static void emit_jalr(const char *dest, MipsCode &s)
 {
-  s << SUB << dest << " " << src1 << " " << src2 << std::endl;
+  s.append(Instr(OP_JALR, NULL, dest));
 }
 
-static void emit_sll(const char *dest, const char *src1, int num, ostream &s)
+static void emit_jr(const char *src, MipsCode &s)
 {
-  s << SLL << dest << " " << src1 << " " << num << std::endl;
+  s.append(Instr(OP_JR, NULL, src));
 }
 
-static void emit_jalr(const char *dest, ostream &s)
+static void emit_jal(const std::string &address, MipsCode &s)
 {
-  s << JALR << "\t" << dest << std::endl;
+  emit_symbol_instr(OP_JAL, NULL, address, s);
 }
 
-static void emit_jal(char *address, ostream &s)
+static void emit_jump(const std::string &address, MipsCode &s)
 {
-  s << JAL << address << endl;
+  emit_symbol_instr(OP_JUMP, NULL, address, s);
 }
 
-static void emit_return(ostream &s)
+static void emit_return(MipsCode &s)
 {
-  s << RET << std::endl;
+  s.append(Instr(OP_RET));
 }
 
-static void emit_gc_assign(ostream &s)
+static void emit_gc_assign(MipsCode &s)
 {
-  s << JAL << "_GenGC_Assign" << std::endl;
+  emit_jal("_GenGC_Assign", s);
 }
 
-static void emit_gc_assign_call(ostream &s, Register reg, int offset)
+static void emit_gc_assign_call(MipsCode &s, Register reg, int offset)
 {
   if (cgen_Memmgr == GC_GENGC)
   {
@@ -213,97 +252,96 @@ static void emit_gc_assign_call(ostream &s, Register reg, int offset)
   }
 }
 
-static void emit_disptable_ref(Symbol sym, ostream &s)
+static std::string disptable_ref(Symbol sym)
 {
-  s << sym << DISPTAB_SUFFIX;
+  return std::string(sym->get_string()) + DISPTAB_SUFFIX;
 }
 
-static void emit_init_ref(Symbol sym, ostream &s)
+static std::string init_ref(Symbol sym)
 {
-  s << sym << CLASSINIT_SUFFIX;
+  return std::string(sym->get_string()) + CLASSINIT_SUFFIX;
 }
 
-static void emit_label_ref(int l, ostream &s)
+static std::string protobj_ref(Symbol sym)
 {
-  s << get_label_ref(l);
+  return std::string(sym->get_string()) + PROTOBJ_SUFFIX;
 }
 
-static void emit_protobj_ref(Symbol sym, ostream &s)
+static std::string method_ref(Symbol classname, Symbol methodname)
 {
-  s << sym << PROTOBJ_SUFFIX;
+  return std::string(classname->get_string()) + METHOD_SEP + methodname->get_string();
 }
 
-static void emit_method_ref(Symbol classname, Symbol methodname, ostream &s)
+static std::string label_ref(int l)
 {
-  s << classname << METHOD_SEP << methodname;
+  return "label" + std::to_string(l);
 }
 
-static void emit_label_def(int l, ostream &s)
+static void emit_label_def(int l, MipsCode &s)
 {
-  emit_label_ref(l, s);
-  s << ":" << std::endl;
+  emit_label_instr(OP_LABEL, l, s);
 }
 
-static void emit_beqz(const char *source, int label, ostream &s)
+static void emit_entry_def(const std::string &name, MipsCode &s)
 {
-  s << BEQZ << source << " ";
-  emit_label_ref(label, s);
-  s << std::endl;
+  emit_symbol_instr(OP_ENTRY, NULL, name, s);
 }
 
-static void emit_beq(const char *src1, const char *src2, int label, ostream &s)
+static void emit_beqz(const char *source, int label, MipsCode &s)
 {
-  s << BEQ << src1 << " " << src2 << " ";
-  emit_label_ref(label, s);
-  s << std::endl;
+  emit_label_instr(OP_BEQZ, label, s).rs = source;
 }
 
-static void emit_bne(const char *src1, const char *src2, int label, ostream &s)
+static void emit_branch2(Opcode op, const char *src1, const char *src2, int label, MipsCode &s)
 {
-  s << BNE << src1 << " " << src2 << " ";
-  emit_label_ref(label, s);
-  s << std::endl;
+  Instr &instr = emit_label_instr(op, label, s);
+  instr.rs = src1;
+  instr.rt = src2;
 }
 
-static void emit_bleq(const char *src1, const char *src2, int label, ostream &s)
+static void emit_beq(const char *src1, const char *src2, int label, MipsCode &s)
 {
-  s << BLEQ << src1 << " " << src2 << " ";
-  emit_label_ref(label, s);
-  s << std::endl;
+  emit_branch2(OP_BEQ, src1, src2, label, s);
 }
 
-static void emit_blt(const char *src1, const char *src2, int label, ostream &s)
+static void emit_bne(const char *src1, const char *src2, int label, MipsCode &s)
 {
-  s << BLT << src1 << " " << src2 << " ";
-  emit_label_ref(label, s);
-  s << std::endl;
+  emit_branch2(OP_BNE, src1, src2, label, s);
 }
 
-static void emit_blti(const char *src1, int imm, int label, ostream &s)
+static void emit_bleq(const char *src1, const char *src2, int label, MipsCode &s)
 {
-  s << BLT << src1 << " " << imm << " ";
-  emit_label_ref(label, s);
-  s << std::endl;
+  emit_branch2(OP_BLEQ, src1, src2, label, s);
 }
 
-static void emit_bgti(const char *src1, int imm, int label, ostream &s)
+static void emit_blt(const char *src1, const char *src2, int label, MipsCode &s)
 {
-  s << BGT << src1 << " " << imm << " ";
-  emit_label_ref(label, s);
-  s << std::endl;
+  emit_branch2(OP_BLT, src1, src2, label, s);
 }
 
-static void emit_branch(int l, ostream &s)
+static void emit_blti(const char *src1, int imm, int label, MipsCode &s)
 {
-  s << BRANCH;
-  emit_label_ref(l, s);
-  s << std::endl;
+  Instr &instr = emit_label_instr(OP_BLTI, label, s);
+  instr.rs = src1;
+  instr.imm = imm;
+}
+
+static void emit_bgti(const char *src1, int imm, int label, MipsCode &s)
+{
+  Instr &instr = emit_label_instr(OP_BGTI, label, s);
+  instr.rs = src1;
+  instr.imm = imm;
+}
+
+static void emit_branch(int l, MipsCode &s)
+{
+  emit_label_instr(OP_BRANCH, l, s);
 }
 
 //
 // Push a register on the stack. The stack grows towards smaller addresses.
 //
-static void emit_push(const char *reg, ostream &str)
+static void emit_push(const char *reg, MipsCode &str)
 {
   emit_store(reg, 0, SP, str);
   emit_addiu(SP, SP, -4, str);
@@ -313,7 +351,7 @@ static void emit_push(const char *reg, ostream &str)
 // Fetch the integer value in an Int object. Emits code to fetch the integer
 // value of the Integer object pointed to by register source into the register dest
 //
-static void emit_fetch_int(const char *dest, const char *source, ostream &s)
+static void emit_fetch_int(const char *dest, const char *source, MipsCode &s)
 {
   emit_load(dest, DEFAULT_OBJFIELDS, source, s);
 }
@@ -322,44 +360,95 @@ static void emit_fetch_int(const char *dest, const char *source, ostream &s)
 // Emits code to store the integer value contained in register source
 // into the Integer object pointed to by dest.
 //
-static void emit_store_int(const char *source, const char *dest, ostream &s)
+static void emit_store_int(const char *source, const char *dest, MipsCode &s)
 {
   emit_store(source, DEFAULT_OBJFIELDS, dest, s);
 }
 
-static void emit_test_collector(ostream &s)
+//
+// Emits code to allocate a new Int object into ACC.  Its value is left
+// to the caller.
+//
+static void emit_new_int(MipsCode &s)
+{
+  emit_load_address(ACC, protobj_ref(Int), s);
+  emit_jal(method_ref(Object, ::copy), s);
+}
+
+static void emit_test_collector(MipsCode &s)
 {
   emit_push(ACC, s);
   emit_move(ACC, SP, s);  // stack end
   emit_move(A1, ZERO, s); // allocate nothing
-  s << JAL << gc_collect_names[cgen_Memmgr] << endl;
+  emit_jal(gc_collect_names[cgen_Memmgr], s);
   emit_addiu(SP, SP, 4, s);
   emit_load(ACC, 0, SP, s);
 }
 
-static void emit_gc_check(const char *source, ostream &s)
+static void emit_gc_check(const char *source, MipsCode &s)
 {
   if (strcmp(source, A1))
     emit_move(A1, source, s);
-  s << JAL << "_gc_check" << std::endl;
+  emit_jal("_gc_check", s);
 }
 
-static void emit_prologue(ostream &s)
+//
+// The registers a routine saves on entry.  Routines that make calls save
+// all three.  A leaf method leaves $ra where it is and saves $fp and $s0
+// only if its body uses them.  The saved registers sit below the
+// arguments in the order $fp, $s0, $ra, and $fp points just above them,
+// so formals have the same offsets in every kind of frame.  Below them
+// are the let and case slots reserved for the whole body, zeroed when
+// there is a collector to scan them.
+//
+struct FrameLayout
+{
+  Boolean save_fp;
+  Boolean save_self;
+  Boolean save_ra;
+  int slots;
+
+  int saved() const { return save_fp + save_self + save_ra; }
+  int size() const { return saved() + slots; }
+};
+
+static const FrameLayout FULL_FRAME = {true, true, true, 0};
+
+static void emit_prologue(MipsCode &s, const FrameLayout &frame = FULL_FRAME)
 {
-  emit_addiu(SP, SP, -(WORD_SIZE * 3), s);
-  emit_store(FP, 3, SP, s);
-  emit_store(SELF, 2, SP, s);
-  emit_store(RA, 1, SP, s);
-  emit_addiu(FP, SP, WORD_SIZE * 4, s);
-  emit_move(SELF, ACC, s);
+  int slot = frame.size();
+  if (slot)
+    emit_addiu(SP, SP, -(WORD_SIZE * slot), s);
+
+  if (frame.save_fp)
+    emit_store(FP, slot--, SP, s);
+  if (frame.save_self)
+    emit_store(SELF, slot--, SP, s);
+  if (frame.save_ra)
+    emit_store(RA, slot--, SP, s);
+
+  if (cgen_Memmgr != GC_NOGC)
+    for (; slot > 0; slot--)
+      emit_store(ZERO, slot, SP, s);
+
+  if (frame.save_fp)
+    emit_addiu(FP, SP, WORD_SIZE * (frame.size() + 1), s);
+  if (frame.save_self)
+    emit_move(SELF, ACC, s);
 }
 
-static void emit_epilogue(ostream &s, int sp_offset = 0)
+static void emit_epilogue(MipsCode &s, int sp_offset = 0, const FrameLayout &frame = FULL_FRAME)
 {
-  emit_load(FP, 3, SP, s);
-  emit_load(SELF, 2, SP, s);
-  emit_load(RA, 1, SP, s);
-  emit_addiu(SP, SP, 12 + (WORD_SIZE * sp_offset), s);
+  int slot = frame.size();
+  if (frame.save_fp)
+    emit_load(FP, slot--, SP, s);
+  if (frame.save_self)
+    emit_load(SELF, slot--, SP, s);
+  if (frame.save_ra)
+    emit_load(RA, slot--, SP, s);
+
+  if (frame.size() + sp_offset)
+    emit_addiu(SP, SP, WORD_SIZE * (frame.size() + sp_offset), s);
   emit_return(s);
 }
 
@@ -378,17 +467,17 @@ void StringEntry::code_def(ostream &s, int stringclasstag)
 {
   IntEntryP lensym = inttable.add_int(len);
 
-  s << WORD << "-1" << std::endl;
+  s << WORD << "-1" << "\n";
 
   code_ref(s);
   s << LABEL                                                                   // label
-    << WORD << stringclasstag << std::endl                                     // tag
-    << WORD << (DEFAULT_OBJFIELDS + STRING_SLOTS + (len + 4) / 4) << std::endl // size
+    << WORD << stringclasstag << "\n"                                          // tag
+    << WORD << (DEFAULT_OBJFIELDS + STRING_SLOTS + (len + 4) / 4) << "\n"      // size
     << WORD;
-  s << Str << DISPTAB_SUFFIX << std::endl;
+  s << Str << DISPTAB_SUFFIX << "\n";
   s << WORD;
   lensym->code_ref(s);
-  s << std::endl;               // string length
+  s << "\n";                    // string length
   emit_string_constant(s, str); // ascii string
   s << ALIGN;                   // align to word
 }
@@ -419,15 +508,15 @@ void IntEntry::code_ref(ostream &s)
 //
 void IntEntry::code_def(ostream &s, int intclasstag)
 {
-  s << WORD << "-1" << std::endl;
+  s << WORD << "-1" << "\n";
 
   code_ref(s);
   s << LABEL                                                // label
-    << WORD << intclasstag << std::endl                     // class tag
-    << WORD << (DEFAULT_OBJFIELDS + INT_SLOTS) << std::endl // object size
+    << WORD << intclasstag << "\n"                          // class tag
+    << WORD << (DEFAULT_OBJFIELDS + INT_SLOTS) << "\n"      // object size
     << WORD;
-  s << Int << DISPTAB_SUFFIX << std::endl;
-  s << WORD << str << std::endl; // integer value
+  s << Int << DISPTAB_SUFFIX << "\n";
+  s << WORD << str << "\n"; // integer value
 }
 
 //
@@ -458,15 +547,15 @@ void BoolConst::code_ref(ostream &s) const
 //
 void BoolConst::code_def(ostream &s, int boolclasstag)
 {
-  s << WORD << "-1" << std::endl;
+  s << WORD << "-1" << "\n";
 
   code_ref(s);
   s << LABEL                                                 // label
-    << WORD << boolclasstag << std::endl                     // class tag
-    << WORD << (DEFAULT_OBJFIELDS + BOOL_SLOTS) << std::endl // object size
+    << WORD << boolclasstag << "\n"                          // class tag
+    << WORD << (DEFAULT_OBJFIELDS + BOOL_SLOTS) << "\n"      // object size
     << WORD;
-  s << Bool << DISPTAB_SUFFIX << std::endl; // dispatch table
-  s << WORD << val << std::endl;            // value (0 or 1)
+  s << Bool << DISPTAB_SUFFIX << "\n";      // dispatch table
+  s << WORD << val << "\n";                 // value (0 or 1)
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -490,25 +579,19 @@ void CgenClassTable::code_global_data()
   //
   // The following global names must be defined first.
   //
-  str << GLOBAL << CLASSNAMETAB << std::endl;
-  str << GLOBAL;
-  emit_protobj_ref(main, str);
-  str << std::endl;
-  str << GLOBAL;
-  emit_protobj_ref(integer, str);
-  str << std::endl;
-  str << GLOBAL;
-  emit_protobj_ref(string, str);
-  str << std::endl;
+  str << GLOBAL << CLASSNAMETAB << "\n";
+  str << GLOBAL << protobj_ref(main) << "\n";
+  str << GLOBAL << protobj_ref(integer) << "\n";
+  str << GLOBAL << protobj_ref(string) << "\n";
   str << GLOBAL;
   falsebool.code_ref(str);
-  str << std::endl;
+  str << "\n";
   str << GLOBAL;
   truebool.code_ref(str);
-  str << std::endl;
-  str << GLOBAL << INTTAG << std::endl;
-  str << GLOBAL << BOOLTAG << std::endl;
-  str << GLOBAL << STRINGTAG << std::endl;
+  str << "\n";
+  str << GLOBAL << INTTAG << "\n";
+  str << GLOBAL << BOOLTAG << "\n";
+  str << GLOBAL << STRINGTAG << "\n";
 
   //
   // We also need to know the tag of the Int, String, and Bool classes
@@ -520,12 +603,12 @@ void CgenClassTable::code_global_data()
   int boolclasstag = *class_to_tag_table.lookup(boolc);
 
   str << INTTAG << LABEL
-      << WORD << intclasstag << std::endl;
+      << WORD << intclasstag << "\n";
   str << BOOLTAG << LABEL
-      << WORD << boolclasstag << std::endl;
+      << WORD << boolclasstag << "\n";
   str << STRINGTAG << LABEL
       << WORD << stringclasstag
-      << std::endl;
+      << "\n";
 }
 
 //***************************************************
@@ -537,25 +620,15 @@ void CgenClassTable::code_global_data()
 
 void CgenClassTable::code_global_text()
 {
-  str << GLOBAL << HEAP_START << std::endl
+  str << GLOBAL << HEAP_START << "\n"
       << HEAP_START << LABEL
-      << WORD << 0 << std::endl
-      << "\t.text" << std::endl
-      << GLOBAL;
-  emit_init_ref(idtable.add_string("Main"), str);
-  str << std::endl
-      << GLOBAL;
-  emit_init_ref(idtable.add_string("Int"), str);
-  str << std::endl
-      << GLOBAL;
-  emit_init_ref(idtable.add_string("String"), str);
-  str << std::endl
-      << GLOBAL;
-  emit_init_ref(idtable.add_string("Bool"), str);
-  str << std::endl
-      << GLOBAL;
-  emit_method_ref(idtable.add_string("Main"), idtable.add_string("main"), str);
-  str << std::endl;
+      << WORD << 0 << "\n"
+      << "\t.text" << "\n"
+      << GLOBAL << init_ref(idtable.add_string("Main")) << "\n"
+      << GLOBAL << init_ref(idtable.add_string("Int")) << "\n"
+      << GLOBAL << init_ref(idtable.add_string("String")) << "\n"
+      << GLOBAL << init_ref(idtable.add_string("Bool")) << "\n"
+      << GLOBAL << method_ref(idtable.add_string("Main"), idtable.add_string("main")) << "\n";
 }
 
 void CgenClassTable::code_bools()
@@ -570,15 +643,15 @@ void CgenClassTable::code_bools()
 //
 void CgenClassTable::code_select_gc()
 {
-  str << GLOBAL << "_MemMgr_INITIALIZER" << std::endl;
-  str << "_MemMgr_INITIALIZER:" << std::endl;
-  str << WORD << gc_init_names[cgen_Memmgr] << std::endl;
-  str << GLOBAL << "_MemMgr_COLLECTOR" << std::endl;
-  str << "_MemMgr_COLLECTOR:" << std::endl;
-  str << WORD << gc_collect_names[cgen_Memmgr] << std::endl;
-  str << GLOBAL << "_MemMgr_TEST" << std::endl;
-  str << "_MemMgr_TEST:" << std::endl;
-  str << WORD << (cgen_Memmgr_Test == GC_TEST) << std::endl;
+  str << GLOBAL << "_MemMgr_INITIALIZER" << "\n";
+  str << "_MemMgr_INITIALIZER:" << "\n";
+  str << WORD << gc_init_names[cgen_Memmgr] << "\n";
+  str << GLOBAL << "_MemMgr_COLLECTOR" << "\n";
+  str << "_MemMgr_COLLECTOR:" << "\n";
+  str << WORD << gc_collect_names[cgen_Memmgr] << "\n";
+  str << GLOBAL << "_MemMgr_TEST" << "\n";
+  str << "_MemMgr_TEST:" << "\n";
+  str << WORD << (cgen_Memmgr_Test == GC_TEST) << "\n";
 }
 
 //********************************************************
@@ -607,19 +680,45 @@ void CgenClassTable::code_constants()
   code_bools();
 }
 
-CgenClassTable::CgenClassTable(Classes classes, ostream &s) : str(s), next_tag(0)
+CgenClassTable::CgenClassTable(Classes classes, ostream &s) : str(s), next_tag(0),
+                                                                free_temps(std::begin(temp_registers), std::end(temp_registers)),
+                                                                pruned(false),
+                                                                tail_call_label(-1),
+                                                                fixed_slots(false),
+                                                                next_slot(0),
+                                                                frame_base(0)
 {
   class_to_tag_table.enterscope();
   enterscope();
 
   if (cgen_debug)
     std::cerr << "Building CgenClassTable" << std::endl;
-  install_basic_classes();
-  install_classes(classes);
-  build_inheritance_tree();
-  install_tags(root());
 
-  code();
+  {
+    TimeSpan span("phase", "cgen_layout");
+    install_basic_classes();
+    install_classes(classes);
+    build_inheritance_tree();
+    build_basic_layouts();
+    build_layouts(root());
+    analyze_hierarchy(root());
+
+    if (cgen_optimize)
+    {
+      fold_constants();
+      eliminate_dead_code();
+
+      // Without the dead subclasses more slots have a single target.
+      analyze_hierarchy(root());
+    }
+
+    install_tags(root());
+  }
+
+  {
+    TimeSpan span("phase", "cgen_emission");
+    code();
+  }
   exitscope();
 }
 
@@ -646,99 +745,14 @@ void CgenClassTable::install_basic_classes()
                      Basic, this));
 
   //
-  // The Object class has no parent class. Its methods are
-  //        cool_abort() : Object    aborts the program
-  //        type_name() : Str        returns a string representation of class name
-  //        copy() : SELF_TYPE       returns a copy of the object
-  //
-  // There is no need for method bodies in the basic classes---these
-  // are already built in to the runtime system.
-  //
-  install_class(
-      new CgenNode(
-          class_(Object,
-                 No_class,
-                 append_Features(
-                     append_Features(
-                         single_Features(method(cool_abort, nil_Formals(), Object, no_expr())),
-                         single_Features(method(type_name, nil_Formals(), Str, no_expr()))),
-                     single_Features(method(::copy, nil_Formals(), SELF_TYPE, no_expr()))),
-                 filename),
-          Basic, this));
-
-  //
-  // The IO class inherits from Object. Its methods are
-  //        out_string(Str) : SELF_TYPE          writes a string to the output
-  //        out_int(Int) : SELF_TYPE               "    an int    "  "     "
-  //        in_string() : Str                    reads a string from the input
-  //        in_int() : Int                         "   an int     "  "     "
-  //
-  install_class(
-      new CgenNode(
-          class_(IO,
-                 Object,
-                 append_Features(
-                     append_Features(
-                         append_Features(
-                             single_Features(method(out_string, single_Formals(formal(arg, Str)),
-                                                    SELF_TYPE, no_expr())),
-                             single_Features(method(out_int, single_Formals(formal(arg, Int)),
-                                                    SELF_TYPE, no_expr()))),
-                         single_Features(method(in_string, nil_Formals(), Str, no_expr()))),
-                     single_Features(method(in_int, nil_Formals(), Int, no_expr()))),
-                 filename),
-          Basic, this));
-
-  //
-  // The Int class has no methods and only a single attribute, the
-  // "val" for the integer.
+  // Object, IO, Int, Bool and String come from the shared description in
+  // basic_classes.h, which also fixes their dispatch table order.
   //
-  install_class(
-      new CgenNode(
-          class_(Int,
-                 Object,
-                 single_Features(attr(val, prim_slot, no_expr())),
-                 filename),
-          Basic, this));
-
-  //
-  // Bool also has only the "val" slot.
-  //
-  install_class(
-      new CgenNode(
-          class_(Bool, Object, single_Features(attr(val, prim_slot, no_expr())), filename),
-          Basic, this));
-
-  //
-  // The class Str has a number of slots and operations:
-  //       val                                  the string's length
-  //       str_field                            the string itself
-  //       length() : Int                       length of the string
-  //       concat(arg: Str) : Str               string concatenation
-  //       substr(arg: Int, arg2: Int): Str     substring
-  //
-  install_class(
-      new CgenNode(
-          class_(Str,
-                 Object,
-                 append_Features(
-                     append_Features(
-                         append_Features(
-                             append_Features(
-                                 single_Features(attr(val, Int, no_expr())),
-                                 single_Features(attr(str_field, prim_slot, no_expr()))),
-                             single_Features(method(length, nil_Formals(), Int, no_expr()))),
-                         single_Features(method(concat,
-                                                single_Formals(formal(arg, Str)),
-                                                Str,
-                                                no_expr()))),
-                     single_Features(method(substr,
-                                            append_Formals(single_Formals(formal(arg, Int)),
-                                                           single_Formals(formal(arg2, Int))),
-                                            Str,
-                                            no_expr()))),
-                 filename),
-          Basic, this));
+  for (int c = 0; c < N_BASIC_CLASSES; c++)
+  {
+    basic_nodes[c] = new CgenNode(basic_class(basic_class_info[c], basic_symbols, filename), Basic, this);
+    install_class(basic_nodes[c]);
+  }
 }
 
 // CgenClassTable::install_class
@@ -784,6 +798,8 @@ void CgenClassTable::install_tags(CgenNodeP nd)
 
   for (auto &child : nd->get_children())
     install_tags(child);
+
+  nd->max_tag = next_tag - 1;
 }
 
 //
@@ -830,17 +846,41 @@ void CgenClassTable::code()
 
   code_tree(root());
 
-  code_global_text();
-
+  // The method code is built before the data is finished: case
+  // expressions add their jump tables to it.
   code_init(root());
   code_methods(root());
+
+  if (peephole_enabled(cgen_optimize))
+  {
+    TimeSpan span("phase", "peephole");
+    Peephole peephole;
+    peephole.run(text);
+    if (peephole_report_enabled())
+      peephole.report(std::cerr);
+  }
+
+  code_jump_tables();
+  code_global_text();
+
+  text.print(str);
+}
+
+void CgenClassTable::code_jump_tables()
+{
+  for (const auto &table : jump_tables)
+  {
+    str << label_ref(table.label) << LABEL;
+    for (int target : table.targets)
+      str << WORD << label_ref(target) << "\n";
+  }
 }
 
 void CgenClassTable::code_class_nameTab(CgenNodeP nd)
 {
   str << WORD;
   stringtable.lookup_string(nd->get_name()->get_string())->code_ref(str);
-  str << std::endl;
+  str << "\n";
 
   for (const auto &child : nd->get_children())
     code_class_nameTab(child);
@@ -848,8 +888,8 @@ void CgenClassTable::code_class_nameTab(CgenNodeP nd)
 
 void CgenClassTable::code_class_objTab(CgenNodeP nd)
 {
-  str << WORD << nd->get_name() << PROTOBJ_SUFFIX << std::endl;
-  str << WORD << nd->get_name() << CLASSINIT_SUFFIX << std::endl;
+  str << WORD << nd->get_name() << PROTOBJ_SUFFIX << "\n";
+  str << WORD << nd->get_name() << CLASSINIT_SUFFIX << "\n";
 
   for (const auto &child : nd->get_children())
     code_class_objTab(child);
@@ -857,7 +897,7 @@ void CgenClassTable::code_class_objTab(CgenNodeP nd)
 
 void CgenClassTable::code_tree(CgenNodeP nd)
 {
-  nd->code(str, *class_to_tag_table.lookup(nd->get_name()));
+  nd->code(str, *class_to_tag_table.lookup(nd->get_name()), this);
 
   for (const auto &child : nd->get_children())
     code_tree(child);
@@ -865,21 +905,129 @@ void CgenClassTable::code_tree(CgenNodeP nd)
 
 void CgenClassTable::code_init(CgenNodeP nd)
 {
-  nd->code_init(str, this);
+  nd->code_init(text, this);
 
   for (auto &child : nd->get_children())
     code_init(child);
 }
 
+//
+// The basic classes take their dispatch tables and attribute layouts from
+// basic_layouts, which already include everything they inherit.
+//
+void CgenClassTable::build_basic_layouts()
+{
+  for (int c = 0; c < N_BASIC_CLASSES; c++)
+    basic_nodes[c]->layout_basic(basic_layouts[c], basic_nodes);
+}
+
+void CgenClassTable::build_layouts(CgenNodeP nd)
+{
+  if (!nd->basic())
+    nd->layout();
+
+  for (auto &child : nd->get_children())
+    build_layouts(child);
+}
+
 void CgenClassTable::code_methods(CgenNodeP nd)
 {
-  if (!basic_classes.count(nd->get_name()->get_string()))
-    nd->code_methods(str, this);
+  if (!symbol_flags.test(nd->get_name(), SYM_BASIC_CLASS))
+    nd->code_methods(text, this);
 
   for (auto &child : nd->get_children())
     code_methods(child);
 }
 
+//
+// Runs bottom-up once every class layout is known, and again once dead
+// classes are pruned.  A slot stays monomorphic in a class only if the
+// class and all of its subclasses agree on the implementation.
+//
+void CgenClassTable::analyze_hierarchy(CgenNodeP nd)
+{
+  for (auto &child : nd->get_children())
+    analyze_hierarchy(child);
+
+  nd->slot_targets.resize(nd->methods.size());
+
+  for (size_t i = 0; i < nd->methods.size(); i++)
+  {
+    Symbol target = nd->methods[i].class_name;
+
+    for (auto &child : nd->get_children())
+      if (child->slot_targets[i] != target)
+        target = NULL;
+
+    nd->slot_targets[i] = target;
+  }
+}
+
+//
+// Drops every class and method body that cannot run starting from
+// Main_init and Main.main.  Dead classes form whole subtrees (a live
+// class keeps its ancestors live), so removing them before tags are
+// assigned keeps subclass tag ranges contiguous.  Slots are numbered
+// before this runs and are not renumbered; dispatch table entries for
+// dead methods are emitted as 0.
+//
+void CgenClassTable::eliminate_dead_code()
+{
+  for (auto nd : nds)
+    nd->live = false;
+
+  Reachability(this).run();
+  prune_dead_classes(root());
+  pruned = true;
+}
+
+//
+// Folds constant subexpressions of every method body and attribute
+// initializer in place.  Runs before dead code elimination so the arms
+// of a constant if or while that can never run keep nothing alive.
+//
+void CgenClassTable::fold_constants()
+{
+  for (auto nd : nds)
+  {
+    if (nd->basic())
+      continue;
+
+    Features f = nd->get_features();
+    for (int i = f->first(); f->more(i); i = f->next(i))
+      f->nth(i)->set_expr(f->nth(i)->get_expr()->fold());
+  }
+}
+
+void CgenClassTable::prune_dead_classes(CgenNodeP nd)
+{
+  nd->get_children().remove_if([](CgenNodeP child)
+                               { return !child->live; });
+
+  for (auto &child : nd->get_children())
+    prune_dead_classes(child);
+}
+
+bool CgenClassTable::is_dead(const Method &method)
+{
+  return pruned && !lookup(method.class_name)->basic() && !live_methods.count(method.nd);
+}
+
+Register CgenClassTable::acquire_temp()
+{
+  if (free_temps.empty())
+    return NULL;
+
+  Register temp = free_temps.back();
+  free_temps.pop_back();
+  return temp;
+}
+
+void CgenClassTable::release_temp(Register temp)
+{
+  free_temps.push_back(temp);
+}
+
 CgenNodeP CgenClassTable::root()
 {
   return probe(Object);
@@ -893,51 +1041,115 @@ CgenNodeP CgenClassTable::root()
 
 CgenNode::CgenNode(Class_ nd, Basicness bstatus, CgenClassTableP ct) : class__class((const class__class &)*nd),
                                                                        parentnd(NULL),
-                                                                       basic_status(bstatus)
+                                                                       basic_status(bstatus),
+                                                                       live(true),
+                                                                       max_tag(-1)
 {
   stringtable.add_string(name->get_string());
   variables.enterscope();
 }
 
-void CgenNode::code_method(ostream &s, Feature &f, CgenClassTableP class_table)
+void CgenNode::code_method(MipsCode &s, Feature &f, CgenClassTableP class_table)
 {
+  TimeSpan span("method", get_name()->get_string(), f->get_name()->get_string());
   variables.enterscope();
 
   Formals cur_formals = f->get_formals();
 
+  if (cgen_optimize)
+  {
+    Nullness nullness(class_table, this);
+    for (int i = cur_formals->first(); cur_formals->more(i); i = cur_formals->next(i))
+      nullness.bind(cur_formals->nth(i)->get_name(), FALSE);
+    f->get_expr()->non_void(nullness);
+  }
+
+  if (cgen_optimize && cgen_Memmgr == GC_NOGC)
+  {
+    Unboxing unboxing(class_table);
+    for (int i = cur_formals->first(); cur_formals->more(i); i = cur_formals->next(i))
+      unboxing.bind(cur_formals->nth(i)->get_name(), NULL);
+    f->get_expr()->plan_unboxing(unboxing, false);
+    unboxing.finish();
+
+    Escape escape(class_table);
+    f->get_expr()->plan_stack_objects(escape);
+  }
+
   int counter = cur_formals->len() - 1;
   for (int i = cur_formals->first(); cur_formals->more(i); i = cur_formals->next(i))
     variables.addid(cur_formals->nth(i)->get_name(), new Variable{counter--, FP});
 
-  s << get_name() << METHOD_SEP << f->get_name() << LABEL;
-  emit_prologue(s);
-  f->get_expr()->code(s, this, class_table, 4);
-  emit_epilogue(s, cur_formals->len());
+  Boolean tail_calls = cgen_optimize && f->get_expr()->mark_tail_calls(f, this, class_table);
+
+  FrameLayout frame = FULL_FRAME;
+  if (cgen_optimize && f->get_expr()->call_free(this, class_table))
+  {
+    FrameUse use = {false, false};
+    f->get_expr()->frame_use(this, use);
+    frame = FrameLayout{use.fp, use.self, false, 0};
+  }
+
+  if (cgen_optimize)
+    frame.slots = f->get_expr()->slot_depth(class_table);
+
+  emit_entry_def(method_ref(get_name(), f->get_name()), s);
+  emit_prologue(s, frame);
+
+  if (tail_calls)
+  {
+    class_table->tail_call_label = labelCounter++;
+    emit_label_def(class_table->tail_call_label, s);
+  }
+  class_table->fixed_slots = cgen_optimize;
+  class_table->next_slot = frame.saved() + 1;
+  class_table->frame_base = frame.saved() + 1 + frame.slots;
+
+  f->get_expr()->code(s, this, class_table, class_table->frame_base);
+  emit_epilogue(s, cur_formals->len(), frame);
+
+  class_table->fixed_slots = false;
 
   variables.exitscope();
 }
 
-void CgenNode::code_methods(ostream &s, CgenClassTableP class_table)
+void CgenNode::code_methods(MipsCode &s, CgenClassTableP class_table)
 {
+  TimeSpan span("class", get_name()->get_string());
   Symbol name = get_name();
   for (auto &method : methods)
   {
-    if (method.class_name == name)
+    if (method.class_name == name && !class_table->is_dead(method))
       code_method(s, method.nd, class_table);
   }
 }
 
-void CgenNode::code_init(ostream &s, CgenClassTableP class_table)
+void CgenNode::code_init(MipsCode &s, CgenClassTableP class_table)
 {
+  emit_entry_def(init_ref(get_name()), s);
+
+  //
+  // With no initializers of its own, a class's init has nothing to do
+  // after its parent's, which already returns the object in ACC.
+  //
+  if (cgen_optimize && !has_initializers())
+  {
+    if (get_parent() != No_class)
+      emit_jump(init_ref(get_parent()), s);
+    else
+      emit_return(s);
+    return;
+  }
+
   variables.enterscope();
-  s << get_name() << CLASSINIT_SUFFIX << LABEL;
   emit_prologue(s);
 
   if (get_parent() != No_class)
-    s << JAL << get_parent() << CLASSINIT_SUFFIX << endl;
+    emit_jal(init_ref(get_parent()), s);
 
-  int offset = parentnd->variables.gettable().front().size();
+  int offset = parentnd->variables.current_scope().size();
   Features f = get_features();
+  Nullness nullness(class_table, this);
 
   for (int i = f->first(); f->more(i); i = f->next(i))
   {
@@ -946,6 +1158,16 @@ void CgenNode::code_init(ostream &s, CgenClassTableP class_table)
     {
       if (!cur->get_expr()->is_no_expr())
       {
+        if (cgen_optimize)
+          nullness.set(cur->get_name(), cur->get_expr()->non_void(nullness));
+
+        if (cgen_optimize && cgen_Memmgr == GC_NOGC)
+        {
+          Unboxing unboxing(class_table);
+          cur->get_expr()->plan_unboxing(unboxing, false);
+          unboxing.finish();
+        }
+
         int loc = DEFAULT_OBJFIELDS + offset;
         cur->get_expr()->code(s, this, class_table, 4);
         emit_store(ACC, loc, SELF, s);
@@ -962,13 +1184,23 @@ void CgenNode::code_init(ostream &s, CgenClassTableP class_table)
   variables.exitscope();
 }
 
-void CgenNode::code(ostream &s, const int &classtag)
+Boolean CgenNode::has_initializers()
+{
+  Features f = get_features();
+  for (int i = f->first(); f->more(i); i = f->next(i))
+    if (f->nth(i)->is_attr() && !f->nth(i)->get_expr()->is_no_expr())
+      return true;
+  return false;
+}
+
+void CgenNode::layout()
 {
   variables = parentnd->variables;
   methods = parentnd->methods;
+  method_slots = parentnd->method_slots;
 
   int method_offset = methods.size();
-  int attr_offset = variables.gettable().front().size() + DEFAULT_OBJFIELDS;
+  int attr_offset = variables.current_scope().size() + DEFAULT_OBJFIELDS;
 
   Features f = get_features();
 
@@ -985,48 +1217,77 @@ void CgenNode::code(ostream &s, const int &classtag)
     }
   }
 
+  attributes = variables;
+}
+
+void CgenNode::layout_basic(const BasicLayout &layout, CgenNodeP const *basic_nodes)
+{
+  variables = parentnd->variables;
+
+  for (int i = variables.current_scope().size(); i < layout.n_attrs; i++)
+  {
+    Feature f = basic_nodes[layout.attrs[i].owner]->features->nth(layout.attrs[i].feature);
+    variables.addid(f->get_name(), new Variable(f, DEFAULT_OBJFIELDS + i, SELF));
+  }
+
+  for (int i = 0; i < layout.n_methods; i++)
+  {
+    CgenNodeP owner = basic_nodes[layout.methods[i].owner];
+    Feature f = owner->features->nth(layout.methods[i].feature);
+    method_slots[f->get_name()] = i;
+    methods.emplace_back(Method{owner->get_name(), f, i});
+  }
+
+  attributes = variables;
+}
+
+void CgenNode::code(ostream &s, const int &classtag, CgenClassTableP class_table)
+{
   code_prot_obj(s, classtag);
-  code_disp_tab(s);
+  code_disp_tab(s, class_table);
 }
 
 void CgenNode::insert_method(const Feature &cur, int &offset)
 {
-  for (auto &method : methods)
+  auto slot = method_slots.find(cur->get_name());
+  if (slot != method_slots.end())
   {
-    if (method.nd->get_name() == cur->get_name())
-    {
-      method.class_name = get_name();
-      method.nd = cur;
-      return;
-    }
+    Method &method = methods[slot->second];
+    method.class_name = get_name();
+    method.nd = cur;
+    return;
   }
 
+  method_slots[cur->get_name()] = offset;
   methods.emplace_back(Method{get_name(), cur, offset++});
 }
 
-void CgenNode::code_disp_tab(ostream &s)
+void CgenNode::code_disp_tab(ostream &s, CgenClassTableP class_table)
 {
   Symbol name = get_name();
-  emit_disptable_ref(name, s);
-  s << LABEL;
+  s << disptable_ref(name) << LABEL;
 
   for (const auto &method : methods)
-    s << WORD << method.class_name << METHOD_SEP << method.nd->get_name() << std::endl;
+  {
+    if (class_table->is_dead(method))
+      s << WORD << EMPTYSLOT << "\n";
+    else
+      s << WORD << method.class_name << METHOD_SEP << method.nd->get_name() << "\n";
+  }
 }
 
 void CgenNode::code_prot_obj(ostream &s, const int &classtag)
 {
-  const auto &attrs = variables.gettable().front();
+  const auto &attrs = variables.current_scope();
 
-  s << WORD << "-1" << std::endl;
+  s << WORD << "-1" << "\n";
   s << get_name() << PROTOBJ_SUFFIX << LABEL
-    << WORD << classtag << std::endl
-    << WORD << (DEFAULT_OBJFIELDS + attrs.size()) << std::endl
-    << WORD << get_name() << DISPTAB_SUFFIX << std::endl;
+    << WORD << classtag << "\n"
+    << WORD << (DEFAULT_OBJFIELDS + attrs.size()) << "\n"
+    << WORD << get_name() << DISPTAB_SUFFIX << "\n";
 
-  for (auto it = attrs.rbegin(); it != attrs.rend(); ++it)
+  for (const auto &attr : attrs)
   {
-    auto attr = *it;
     s << WORD;
 
     Symbol type = attr.get_info()->nd->get_type_decl();
@@ -1047,24 +1308,91 @@ void CgenNode::code_prot_obj(ostream &s, const int &classtag)
     {
       s << 0;
     }
-    s << std::endl;
+    s << "\n";
   }
 }
 
-void assign_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+//
+// Under -O the left operand of a binary expression waits in a spare
+// register rather than a stack slot when the right operand makes no
+// calls.  Only calls allocate, so the collector never runs while a
+// pointer is held in one of these registers, and no callee can clobber
+// it.  frame_height counts only the slots actually pushed, so let and
+// case slots inside the right operand stay consistent.
+//
+namespace temp_helpers
 {
-  expr->code(s, nd, class_tab, frame_height);
+  // Saves ACC; returns the register holding it, or NULL if it was pushed.
+  Register save_acc(Boolean call_free, MipsCode &s, CgenClassTableP class_tab, int &frame_height)
+  {
+    Register temp = (cgen_optimize && call_free) ? class_tab->acquire_temp() : NULL;
+    if (temp)
+    {
+      emit_move(temp, ACC, s);
+    }
+    else
+    {
+      emit_push(ACC, s);
+      frame_height++;
+    }
+    return temp;
+  }
+
+  void restore(Register dest, Register temp, MipsCode &s, CgenClassTableP class_tab, int &frame_height)
+  {
+    if (temp)
+    {
+      emit_move(dest, temp, s);
+      class_tab->release_temp(temp);
+    }
+    else
+    {
+      emit_load(dest, 1, SP, s);
+      emit_addiu(SP, SP, WORD_SIZE, s);
+      frame_height--;
+    }
+  }
+}
 
+void assign_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+{
   Variable *cur = nd->variables.lookup(name);
+  if (cur->raw)
+  {
+    code_int(s, nd, class_tab, frame_height);
+    if (!class_tab->unused_values.count(this))
+    {
+      emit_new_int(s);
+      emit_load(T1, cur->offset, cur->reg, s);
+      emit_store_int(T1, ACC, s);
+    }
+    return;
+  }
+
+  expr->code(s, nd, class_tab, frame_height);
+
   emit_store(ACC, cur->offset, cur->reg, s);
 
   if (cur->reg == SELF)
     emit_gc_assign_call(s, cur->reg, cur->offset);
 }
 
+void assign_class::code_int(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+{
+  Variable *cur = nd->variables.lookup(name);
+  if (!cur->raw)
+  {
+    Expression_class::code_int(s, nd, class_tab, frame_height);
+    return;
+  }
+
+  expr->code_int(s, nd, class_tab, frame_height);
+  emit_store(ACC, cur->offset, cur->reg, s);
+}
+
 namespace dispatch_helpers
 {
-  void emit_arguments(const Expressions &actual, ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int &frame_height)
+  void emit_arguments(const Expressions &actual, MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int &frame_height)
   {
     for (int i = actual->first(); actual->more(i); i = actual->next(i)) {
       actual->nth(i)->code(s, nd, class_tab, frame_height);
@@ -1073,33 +1401,90 @@ namespace dispatch_helpers
     }
   }
 
-  void emit_dynamic_call(int &offset, ostream &s)
+  void emit_dynamic_call(int &offset, MipsCode &s)
   {
     emit_load(T1, DISPTABLE_OFFSET, ACC, s);
     emit_load(T1, offset, T1, s);
     emit_jalr(T1, s);
   }
 
-  void emit_static_call(int &offset, ostream &s, Symbol type)
+  void emit_direct_call(Symbol class_name, Symbol method_name, MipsCode &s)
   {
-    s << LA << T1 << " " << type << DISPTAB_SUFFIX << std::endl;
-    emit_load(T1, offset, T1, s);
-    emit_jalr(T1, s);
+    emit_jal(method_ref(class_name, method_name), s);
+  }
+
+  //
+  // Expands the body of method in place of a call.  The arguments are
+  // on the stack from args_height up and the receiver is in ACC.  The
+  // body runs with SELF bound to the receiver and sees only its formals
+  // and the attributes of its class; the caller's SELF is saved on the
+  // stack around it.
+  //
+  void emit_inlined_body(const Method &method, int args_height, MipsCode &s, CgenClassTableP class_tab, int frame_height)
+  {
+    CgenNodeP owner = class_tab->lookup(method.class_name);
+    Formals formals = method.nd->get_formals();
+
+    // The caller reserved no slots for the lets of the inlined body.
+    Boolean fixed_slots = class_tab->fixed_slots;
+    class_tab->fixed_slots = false;
+
+    std::swap(owner->variables, owner->attributes);
+    owner->variables.enterscope();
+    for (int i = formals->first(); formals->more(i); i = formals->next(i))
+      owner->variables.addid(formals->nth(i)->get_name(), new Variable(-(args_height + i), FP));
+
+    emit_push(SELF, s);
+    emit_move(SELF, ACC, s);
+    method.nd->get_expr()->code(s, owner, class_tab, frame_height + 1);
+    emit_load(SELF, 1, SP, s);
+    emit_addiu(SP, SP, WORD_SIZE * (formals->len() + 1), s);
+
+    owner->variables.exitscope();
+    std::swap(owner->variables, owner->attributes);
+
+    class_tab->fixed_slots = fixed_slots;
   }
 
-  void find_method(Method &cur, Symbol type, CgenClassTableP class_tab, Symbol method_name)
+  //
+  // A self-call in tail position reuses the current frame.  The new
+  // arguments, pushed from args_height up, overwrite the formals, the
+  // stack is cut back to where the prologue left it, and control goes
+  // back to the start of the body.  self is unchanged.
+  //
+  void emit_tail_call(int n_args, int args_height, MipsCode &s, CgenClassTableP class_tab)
   {
-    for (const auto &method : class_tab->lookup(type)->methods)
+    for (int i = 0; i < n_args; i++)
     {
-      if (method.nd->get_name() == method_name)
-      {
-        cur = method;
-        return;
-      }
+      emit_load(T1, -(args_height + i), FP, s);
+      emit_store(T1, n_args - 1 - i, FP, s);
     }
+    emit_addiu(SP, FP, -class_tab->frame_base * WORD_SIZE, s);
+    emit_branch(class_tab->tail_call_label, s);
+  }
+
+  // A call whose target is known: inlined under -O when it is small.
+  void emit_resolved_call(const Method &method, int line, int args_height, MipsCode &s, CgenNodeP nd,
+                          CgenClassTableP class_tab, int frame_height)
+  {
+    CgenNodeP owner = class_tab->lookup(method.class_name);
+
+    if (cgen_optimize && class_tab->inliner.should_inline(nd, line, owner, method))
+      emit_inlined_body(method, args_height, s, class_tab, frame_height);
+    else
+      emit_direct_call(method.class_name, method.nd->get_name(), s);
+  }
+
+  //
+  // Dispatch table slot of method_name in class type.  Slots are fixed
+  // when the class layout is built, so this is a pair of hash lookups.
+  //
+  int find_method(Symbol type, CgenClassTableP class_tab, Symbol method_name)
+  {
+    return class_tab->lookup(type)->method_slots.at(method_name);
   }
 
-  void emit_void_checker(int line_num, ostream &s)
+  void emit_void_checker(int line_num, MipsCode &s)
   {
     emit_bne(ACC, ZERO, labelCounter, s);
     emit_load_string(ACC, stringtable.lookup(0), s);
@@ -1109,38 +1494,69 @@ namespace dispatch_helpers
   }
 }
 
-void static_dispatch_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void static_dispatch_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
+  int args_height = frame_height;
   dispatch_helpers::emit_arguments(actual, s, nd, class_tab, frame_height);
+
+  if (class_tab->tail_calls.count(this))
+  {
+    dispatch_helpers::emit_tail_call(actual->len(), args_height, s, class_tab);
+    return;
+  }
+
   expr->code(s, nd, class_tab, frame_height);
 
-  dispatch_helpers::emit_void_checker(line_number, s);
+  if (!class_tab->non_void_receivers.count(this))
+    dispatch_helpers::emit_void_checker(line_number, s);
 
-  Method cur;
-  dispatch_helpers::find_method(cur, type_name, class_tab, name);
-  dispatch_helpers::emit_static_call(cur.offset, s, type_name);
+  // The method a static dispatch runs is fixed by the named class.
+  int offset = dispatch_helpers::find_method(type_name, class_tab, name);
+  dispatch_helpers::emit_resolved_call(class_tab->lookup(type_name)->methods[offset], line_number, args_height,
+                                       s, nd, class_tab, frame_height);
 }
 
-void dispatch_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void dispatch_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
+  int args_height = frame_height;
   dispatch_helpers::emit_arguments(actual, s, nd, class_tab, frame_height);
+
+  if (class_tab->tail_calls.count(this))
+  {
+    dispatch_helpers::emit_tail_call(actual->len(), args_height, s, class_tab);
+    return;
+  }
+
   expr->code(s, nd, class_tab, frame_height);
 
-  dispatch_helpers::emit_void_checker(line_number, s);
+  if (!class_tab->non_void_receivers.count(this))
+    dispatch_helpers::emit_void_checker(line_number, s);
+
+  CgenNodeP static_class = class_tab->lookup((expr->get_type() == SELF_TYPE) ? nd->get_name() : expr->get_type());
+  int offset = static_class->method_slots.at(name);
 
-  Method cur;
-  dispatch_helpers::find_method(cur, (expr->get_type() == SELF_TYPE) ? nd->get_name() : expr->get_type(), class_tab, name);
-  dispatch_helpers::emit_dynamic_call(cur.offset, s);
+  Symbol target = static_class->slot_targets[offset];
+  if (target && !class_tab->is_dead(static_class->methods[offset]))
+    dispatch_helpers::emit_resolved_call(static_class->methods[offset], line_number, args_height,
+                                         s, nd, class_tab, frame_height);
+  else
+    dispatch_helpers::emit_dynamic_call(offset, s);
 }
 
-void cond_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void cond_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
-  pred->code(s, nd, class_tab, frame_height);
-
-  emit_load(T1, DEFAULT_OBJFIELDS, ACC, s);
-
   int elseBranch = labelCounter++;
-  emit_beqz(T1, elseBranch, s);
+
+  if (cgen_optimize)
+  {
+    pred->code_branch(s, nd, class_tab, frame_height, FALSE, elseBranch);
+  }
+  else
+  {
+    pred->code(s, nd, class_tab, frame_height);
+    emit_load(T1, DEFAULT_OBJFIELDS, ACC, s);
+    emit_beqz(T1, elseBranch, s);
+  }
 
   then_exp->code(s, nd, class_tab, frame_height);
 
@@ -1153,11 +1569,44 @@ void cond_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int f
   emit_label_def(epilogueBranch, s);
 }
 
-void loop_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void loop_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
+  Boolean constant;
+  Boolean folded = pred->bool_value(constant);
+
+  if (folded && !constant)
+  {
+    emit_move(ACC, ZERO, s);
+    return;
+  }
+
   int loop_start = labelCounter++;
+
+  //
+  // Under -O the test goes after the body, so an iteration runs one
+  // compare-and-branch and nothing else.
+  //
+  if (cgen_optimize && !folded)
+  {
+    int loop_test = labelCounter++;
+    emit_branch(loop_test, s);
+    emit_label_def(loop_start, s);
+    body->code(s, nd, class_tab, frame_height);
+    emit_label_def(loop_test, s);
+    pred->code_branch(s, nd, class_tab, frame_height, TRUE, loop_start);
+    emit_move(ACC, ZERO, s);
+    return;
+  }
+
   emit_label_def(loop_start, s);
 
+  if (folded)
+  {
+    body->code(s, nd, class_tab, frame_height);
+    emit_branch(loop_start, s);
+    return;
+  }
+
   pred->code(s, nd, class_tab, frame_height);
   emit_load(T1, DEFAULT_OBJFIELDS, ACC, s);
 
@@ -1172,15 +1621,68 @@ void loop_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int f
   emit_move(ACC, ZERO, s);
 }
 
-void branch_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+//
+// Under -O the let and case variables of a method live in slots its
+// prologue reserves; otherwise each one is pushed when it is bound and
+// popped when its scope ends.  bind_slot stores ACC in the variable's
+// slot and returns the slot's height.
+//
+static int emit_bind_slot(MipsCode &s, CgenClassTableP class_tab, int &frame_height)
 {
-  nd->variables.enterscope();
-  nd->variables.addid(get_name(), new Variable(-frame_height, FP));
+  if (class_tab->fixed_slots)
+  {
+    int slot = class_tab->next_slot++;
+    emit_store(ACC, -slot, FP, s);
+    return slot;
+  }
+
   emit_push(ACC, s);
+  return frame_height++;
+}
 
-  expr->code(s, nd, class_tab, frame_height + 1);
+static void emit_unbind_slot(MipsCode &s, CgenClassTableP class_tab)
+{
+  if (class_tab->fixed_slots)
+    class_tab->next_slot--;
+  else
+    emit_addiu(SP, SP, WORD_SIZE, s);
+}
 
-  emit_addiu(SP, SP, 4, s);
+//
+// Builds an object of class t in the next size + 1 fixed slots and
+// leaves its address in ACC.  The words are laid out as in the heap: the
+// eyecatcher in the highest slot, then the fields from the tag down.
+// The prototype is copied word by word and t's init runs on the copy,
+// as for new.
+//
+static void emit_stack_new(MipsCode &s, Symbol t, int size, CgenClassTableP class_tab)
+{
+  int eyecatcher = class_tab->next_slot + size;
+  class_tab->next_slot += size + 1;
+
+  emit_load_imm(T2, -1, s);
+  emit_store(T2, -eyecatcher, FP, s);
+
+  emit_load_address(T1, protobj_ref(t), s);
+  for (int i = 0; i < size; i++)
+  {
+    emit_load(T2, i, T1, s);
+    emit_store(T2, -(eyecatcher - 1 - i), FP, s);
+  }
+
+  emit_addiu(ACC, FP, -(eyecatcher - 1) * WORD_SIZE, s);
+  emit_jal(init_ref(t), s);
+}
+
+void branch_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+{
+  nd->variables.enterscope();
+  int slot = emit_bind_slot(s, class_tab, frame_height);
+  nd->variables.addid(get_name(), new Variable(-slot, FP));
+
+  expr->code(s, nd, class_tab, frame_height);
+
+  emit_unbind_slot(s, class_tab);
   nd->variables.exitscope();
 }
 
@@ -1194,35 +1696,165 @@ namespace case_helpers
     CaseBranch(const Case nd) : nd(nd) {}
   };
 
-  int last_descendent(CgenNodeP nd, CgenClassTableP class_tab)
+  // A run of class tags that all select the same branch.
+  struct TagRange
   {
-    int last = *(class_tab->class_to_tag_table.lookup(nd->get_name()));
+    int lo;
+    int hi;
+    int label;
+  };
 
-    for (auto &child : nd->get_children())
-      last = std::max(last, last_descendent(child, class_tab));
+  // Dispatch goes through a jump table when there are at least this many
+  // ranges and they cover at least half of the table.
+  const size_t JUMP_TABLE_MIN_RANGES = 4;
 
-    return last;
+  int tag_of(CgenNodeP nd, CgenClassTableP class_tab)
+  {
+    return *(class_tab->class_to_tag_table.lookup(nd->get_name()));
   }
 
-  void emit_case_on_void(ostream &s, int line_no)
+  void emit_case_on_void(MipsCode &s, int line_no)
   {
-    emit_bne(ACC, ZERO, labelCounter, s);
+    int dispatch = labelCounter++;
+    emit_bne(ACC, ZERO, dispatch, s);
     emit_load_string(ACC, stringtable.lookup(0), s);
     emit_load_imm(T1, line_no, s);
     emit_jal(CASE_ABORT_TWO, s);
+    emit_label_def(dispatch, s);
   }
 
-  void create_case_branches(Cases cases, CgenClassTableP class_tab, std::map<int, CaseBranch, std::greater<int>> &branches)
+  void create_case_branches(Cases cases, CgenClassTableP class_tab, std::map<int, CaseBranch> &branches)
   {
     for (int i = cases->first(); cases->more(i); i = cases->next(i))
     {
       Case cur = cases->nth(i);
-      int tag = *(class_tab->class_to_tag_table.lookup(cur->get_type_decl()));
-      branches.emplace(tag, CaseBranch(cur));
+      int *tag = class_tab->class_to_tag_table.lookup(cur->get_type_decl());
+
+      // No object of a class removed by dead code elimination can exist.
+      if (tag)
+        branches.emplace(*tag, CaseBranch(cur));
+    }
+  }
+
+  //
+  // The tags a branch covers are nested in or disjoint from those of
+  // every other branch, and an object takes the innermost branch that
+  // covers its tag.  Sweeping the branches in tag order splits them into
+  // disjoint ranges, sorted by tag.
+  //
+  void create_tag_ranges(std::map<int, CaseBranch> &branches, CgenClassTableP class_tab, std::vector<TagRange> &ranges)
+  {
+    std::vector<TagRange> open; // enclosing branches, innermost last
+    int next = 0;
+
+    auto close_before = [&](int tag)
+    {
+      while (!open.empty() && open.back().hi < tag)
+      {
+        if (next <= open.back().hi)
+          ranges.push_back(TagRange{next, open.back().hi, open.back().label});
+        next = std::max(next, open.back().hi + 1);
+        open.pop_back();
+      }
+    };
+
+    for (const auto &branch : branches)
+    {
+      close_before(branch.first);
+      if (!open.empty() && next < branch.first)
+        ranges.push_back(TagRange{next, branch.first - 1, open.back().label});
+
+      next = branch.first;
+      int max_tag = class_tab->lookup(branch.second.nd->get_type_decl())->max_tag;
+      open.push_back(TagRange{branch.first, max_tag, branch.second.label});
+    }
+    close_before(INT_MAX);
+  }
+
+  // Drops the tags no object of the case expression's static type can have.
+  void clip_tag_ranges(std::vector<TagRange> &ranges, int lo, int hi)
+  {
+    std::vector<TagRange> clipped;
+    for (const auto &r : ranges)
+      if (r.hi >= lo && r.lo <= hi)
+        clipped.push_back(TagRange{std::max(r.lo, lo), std::min(r.hi, hi), r.label});
+    ranges.swap(clipped);
+  }
+
+  //
+  // Binary search for the tag in T2 over ranges[first, last).  The tag is
+  // known to be between lo and hi, so bounds the search has already
+  // checked are not tested again.
+  //
+  void emit_tag_search(MipsCode &s, const std::vector<TagRange> &ranges, size_t first, size_t last,
+                       int lo, int hi, int missingBranchLabel)
+  {
+    if (first == last)
+    {
+      emit_branch(missingBranchLabel, s);
+      return;
+    }
+
+    if (last - first == 1)
+    {
+      const TagRange &r = ranges[first];
+      if (lo < r.lo)
+        emit_blti(T2, r.lo, missingBranchLabel, s);
+      if (r.hi < hi)
+        emit_bgti(T2, r.hi, missingBranchLabel, s);
+      emit_branch(r.label, s);
+      return;
     }
+
+    size_t mid = first + (last - first) / 2;
+    int lower = labelCounter++;
+
+    emit_blti(T2, ranges[mid].lo, lower, s);
+    emit_tag_search(s, ranges, mid, last, ranges[mid].lo, hi, missingBranchLabel);
+
+    emit_label_def(lower, s);
+    emit_tag_search(s, ranges, first, mid, lo, ranges[mid].lo - 1, missingBranchLabel);
+  }
+
+  bool use_jump_table(const std::vector<TagRange> &ranges)
+  {
+    if (ranges.size() < JUMP_TABLE_MIN_RANGES)
+      return false;
+
+    int covered = 0;
+    for (const auto &r : ranges)
+      covered += r.hi - r.lo + 1;
+
+    return 2 * covered >= ranges.back().hi - ranges.front().lo + 1;
+  }
+
+  void emit_jump_table(MipsCode &s, CgenClassTableP class_tab, const std::vector<TagRange> &ranges,
+                       int lo, int hi, int missingBranchLabel)
+  {
+    int first = ranges.front().lo;
+    int last = ranges.back().hi;
+
+    if (lo < first)
+      emit_blti(T2, first, missingBranchLabel, s);
+    if (last < hi)
+      emit_bgti(T2, last, missingBranchLabel, s);
+
+    CgenClassTable::JumpTable table{labelCounter++, std::vector<int>(last - first + 1, missingBranchLabel)};
+    for (const auto &r : ranges)
+      for (int tag = r.lo; tag <= r.hi; tag++)
+        table.targets[tag - first] = r.label;
+
+    emit_addiu(T2, T2, -first, s);
+    emit_sll(T2, T2, 2, s);
+    emit_load_address(T1, label_ref(table.label), s);
+    emit_addu(T1, T1, T2, s);
+    emit_load(T1, 0, T1, s);
+    emit_jr(T1, s);
+
+    class_tab->jump_tables.push_back(std::move(table));
   }
 
-  void emit_last_labels(ostream &s, int missingBranchLabel, int epilogueLabel)
+  void emit_last_labels(MipsCode &s, int missingBranchLabel, int epilogueLabel)
   {
     emit_label_def(missingBranchLabel, s);
     emit_jal(CASE_ABORT_ONE, s);
@@ -1230,30 +1862,36 @@ namespace case_helpers
     emit_label_def(epilogueLabel, s);
   }
 
-  void generate_case_dispatch(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height,
-                              std::map<int, CaseBranch, std::greater<int>> &branches, int epilogueLabel)
+  void generate_case_dispatch(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height, Symbol type,
+                              std::map<int, CaseBranch> &branches, int epilogueLabel)
   {
     for (auto &branch : branches)
       branch.second.label = labelCounter++;
 
     int missingBranchLabel = labelCounter++;
 
-    bool first = true;
+    // A static type with no tag has no live subclass either; the value
+    // can only be void.
+    CgenNodeP static_class = class_tab->lookup(type == SELF_TYPE ? nd->get_name() : type);
+    if (!class_tab->class_to_tag_table.lookup(static_class->get_name()))
+      static_class = class_tab->root();
+    int lo = tag_of(static_class, class_tab);
+    int hi = static_class->max_tag;
+
+    std::vector<TagRange> ranges;
+    create_tag_ranges(branches, class_tab, ranges);
+    clip_tag_ranges(ranges, lo, hi);
+
+    emit_load(T2, 0, ACC, s);
+    if (use_jump_table(ranges))
+      emit_jump_table(s, class_tab, ranges, lo, hi, missingBranchLabel);
+    else
+      emit_tag_search(s, ranges, 0, ranges.size(), lo, hi, missingBranchLabel);
+
     for (const auto &branch : branches)
     {
       emit_label_def(branch.second.label, s);
-
-      if (first)
-      {
-        emit_load(T2, 0, ACC, s);
-        first = false;
-      }
-
-      emit_blti(T2, branch.first, branch.second.label + 1, s);
-      emit_bgti(T2, case_helpers::last_descendent(class_tab->lookup(branch.second.nd->get_type_decl()), class_tab), branch.second.label + 1, s);
-
       branch.second.nd->code(s, nd, class_tab, frame_height);
-
       emit_branch(epilogueLabel, s);
     }
 
@@ -1261,21 +1899,22 @@ namespace case_helpers
   }
 }
 
-void typcase_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void typcase_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
   int epilogueLabel = labelCounter++;
 
   expr->code(s, nd, class_tab, frame_height);
 
-  case_helpers::emit_case_on_void(s, line_number);
+  if (!class_tab->non_void_receivers.count(this))
+    case_helpers::emit_case_on_void(s, line_number);
 
-  std::map<int, case_helpers::CaseBranch, std::greater<int>> branches;
+  std::map<int, case_helpers::CaseBranch> branches;
   case_helpers::create_case_branches(cases, class_tab, branches);
 
-  case_helpers::generate_case_dispatch(s, nd, class_tab, frame_height, branches, epilogueLabel);
+  case_helpers::generate_case_dispatch(s, nd, class_tab, frame_height, expr->get_type(), branches, epilogueLabel);
 }
 
-void block_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void block_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
   Expressions expr_ls = body;
 
@@ -1283,11 +1922,20 @@ void block_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int
     expr_ls->nth(i)->code(s, nd, class_tab, frame_height);
 }
 
-void let_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void let_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
   nd->variables.enterscope();
 
-  if (init->is_no_expr())
+  Boolean raw = class_tab->unboxed_lets.count(this);
+  int object_size = 0;
+  if (raw)
+  {
+    if (init->is_no_expr())
+      emit_load_imm(ACC, 0, s);
+    else
+      init->code_int(s, nd, class_tab, frame_height);
+  }
+  else if (init->is_no_expr())
   {
     if (type_decl == Int)
     {
@@ -1306,28 +1954,94 @@ void let_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int fr
       emit_move(ACC, ZERO, s);
     }
   }
+  else if (class_tab->fixed_slots && class_tab->stack_objects.count(this))
+  {
+    object_size = class_tab->stack_objects[this];
+    emit_stack_new(s, init->get_type(), object_size, class_tab);
+  }
   else
   {
     init->code(s, nd, class_tab, frame_height);
   }
 
-  nd->variables.addid(identifier, new Variable(-frame_height, FP));
+  int slot = emit_bind_slot(s, class_tab, frame_height);
+  nd->variables.addid(identifier, new Variable(-slot, FP, raw));
 
-  emit_push(ACC, s);
+  body->code(s, nd, class_tab, frame_height);
 
-  body->code(s, nd, class_tab, frame_height + 1);
+  emit_unbind_slot(s, class_tab);
+  if (object_size)
+    class_tab->next_slot -= object_size + 1;
+  nd->variables.exitscope();
+}
 
-  emit_addiu(SP, SP, WORD_SIZE, s);
+//
+// Under -O an Int expression can be evaluated unboxed: code_int leaves
+// its raw value in ACC, and only the outermost arithmetic node allocates
+// an object for the result.  That box is allocated before the operands
+// are evaluated, and a raw operand is only kept on the stack while
+// nothing that can allocate runs, so the collector never meets a raw
+// value where it expects a pointer.  Without a collector the stack is
+// never scanned and raw values may stay there freely.
+//
+namespace arith_helpers
+{
+  Boolean raw_stack_safe(Expression rest)
+  {
+    return cgen_Memmgr == GC_NOGC || rest->allocation_free();
+  }
 
-  nd->variables.exitscope();
+  //
+  // Leaves the raw values of e1 and e2 in T1 and T2.  When e2 may
+  // allocate, e1 waits on the stack as an object.
+  //
+  void emit_raw_operands(Expression e1, Expression e2, MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+  {
+    Boolean raw = raw_stack_safe(e2);
+    if (raw)
+      e1->code_int(s, nd, class_tab, frame_height);
+    else
+      e1->code(s, nd, class_tab, frame_height);
+    Register temp = temp_helpers::save_acc(e2->int_call_free(nd, class_tab), s, class_tab, frame_height);
+
+    e2->code_int(s, nd, class_tab, frame_height);
+    emit_move(T2, ACC, s);
+    temp_helpers::restore(T1, temp, s, class_tab, frame_height);
+
+    if (!raw)
+      emit_fetch_int(T1, T1, s);
+  }
+
+  // Leaves a new Int object holding the value of e in ACC.
+  void emit_boxed(Expression e, MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+  {
+    emit_new_int(s);
+    Register temp = temp_helpers::save_acc(e->int_call_free(nd, class_tab), s, class_tab, frame_height);
+    e->code_int(s, nd, class_tab, frame_height);
+    temp_helpers::restore(T1, temp, s, class_tab, frame_height);
+    emit_store_int(ACC, T1, s);
+    emit_move(ACC, T1, s);
+  }
+}
+
+void Expression_class::code_int(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+{
+  code(s, nd, class_tab, frame_height);
+  emit_fetch_int(ACC, ACC, s);
 }
 
-void plus_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void plus_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
+  if (cgen_optimize)
+  {
+    arith_helpers::emit_boxed(this, s, nd, class_tab, frame_height);
+    return;
+  }
+
   e1->code(s, nd, class_tab, frame_height);
   emit_push(ACC, s);
   e2->code(s, nd, class_tab, frame_height + 1);
-  s << JAL << Object << METHOD_SEP << ::copy << endl;
+  emit_jal(method_ref(Object, ::copy), s);
   emit_load(T1, 1, SP, s);
   emit_fetch_int(T1, T1, s);
   emit_fetch_int(T2, ACC, s);
@@ -1336,12 +2050,24 @@ void plus_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int f
   emit_addiu(SP, SP, WORD_SIZE, s);
 }
 
-void sub_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void plus_class::code_int(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
+  arith_helpers::emit_raw_operands(e1, e2, s, nd, class_tab, frame_height);
+  emit_add(ACC, T1, T2, s);
+}
+
+void sub_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+{
+  if (cgen_optimize)
+  {
+    arith_helpers::emit_boxed(this, s, nd, class_tab, frame_height);
+    return;
+  }
+
   e1->code(s, nd, class_tab, frame_height);
   emit_push(ACC, s);
   e2->code(s, nd, class_tab, frame_height + 1);
-  s << JAL << Object << METHOD_SEP << ::copy << endl;
+  emit_jal(method_ref(Object, ::copy), s);
   emit_load(T1, 1, SP, s);
   emit_fetch_int(T1, T1, s);
   emit_fetch_int(T2, ACC, s);
@@ -1350,12 +2076,24 @@ void sub_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int fr
   emit_addiu(SP, SP, WORD_SIZE, s);
 }
 
-void mul_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void sub_class::code_int(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+{
+  arith_helpers::emit_raw_operands(e1, e2, s, nd, class_tab, frame_height);
+  emit_sub(ACC, T1, T2, s);
+}
+
+void mul_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
+  if (cgen_optimize)
+  {
+    arith_helpers::emit_boxed(this, s, nd, class_tab, frame_height);
+    return;
+  }
+
   e1->code(s, nd, class_tab, frame_height);
   emit_push(ACC, s);
   e2->code(s, nd, class_tab, frame_height + 1);
-  s << JAL << Object << METHOD_SEP << ::copy << endl;
+  emit_jal(method_ref(Object, ::copy), s);
   emit_load(T1, 1, SP, s);
   emit_fetch_int(T1, T1, s);
   emit_fetch_int(T2, ACC, s);
@@ -1364,12 +2102,24 @@ void mul_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int fr
   emit_addiu(SP, SP, WORD_SIZE, s);
 }
 
-void divide_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void mul_class::code_int(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+{
+  arith_helpers::emit_raw_operands(e1, e2, s, nd, class_tab, frame_height);
+  emit_mul(ACC, T1, T2, s);
+}
+
+void divide_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
+  if (cgen_optimize)
+  {
+    arith_helpers::emit_boxed(this, s, nd, class_tab, frame_height);
+    return;
+  }
+
   e1->code(s, nd, class_tab, frame_height);
   emit_push(ACC, s);
   e2->code(s, nd, class_tab, frame_height + 1);
-  s << JAL << Object << METHOD_SEP << ::copy << endl;
+  emit_jal(method_ref(Object, ::copy), s);
   emit_load(T1, 1, SP, s);
   emit_fetch_int(T1, T1, s);
   emit_fetch_int(T2, ACC, s);
@@ -1378,25 +2128,50 @@ void divide_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int
   emit_addiu(SP, SP, WORD_SIZE, s);
 }
 
-void neg_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void divide_class::code_int(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+{
+  arith_helpers::emit_raw_operands(e1, e2, s, nd, class_tab, frame_height);
+  emit_div(ACC, T1, T2, s);
+}
+
+void neg_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
+  if (cgen_optimize)
+  {
+    arith_helpers::emit_boxed(this, s, nd, class_tab, frame_height);
+    return;
+  }
+
   e1->code(s, nd, class_tab, frame_height);
-  s << JAL << Object << METHOD_SEP << ::copy << endl;
+  emit_jal(method_ref(Object, ::copy), s);
   emit_fetch_int(T1, ACC, s);
   emit_neg(T1, T1, s);
   emit_store_int(T1, ACC, s);
 }
 
-void lt_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void neg_class::code_int(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
-  e1->code(s, nd, class_tab, frame_height);
-  emit_push(ACC, s);
-  e2->code(s, nd, class_tab, frame_height + 1);
-  emit_load(T1, 1, SP, s);
-  emit_addiu(SP, SP, WORD_SIZE, s);
+  e1->code_int(s, nd, class_tab, frame_height);
+  emit_neg(ACC, ACC, s);
+}
 
-  emit_fetch_int(T1, T1, s);
-  emit_fetch_int(T2, ACC, s);
+void lt_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+{
+  if (cgen_optimize)
+  {
+    arith_helpers::emit_raw_operands(e1, e2, s, nd, class_tab, frame_height);
+  }
+  else
+  {
+    e1->code(s, nd, class_tab, frame_height);
+    emit_push(ACC, s);
+    e2->code(s, nd, class_tab, frame_height + 1);
+    emit_load(T1, 1, SP, s);
+    emit_addiu(SP, SP, WORD_SIZE, s);
+
+    emit_fetch_int(T1, T1, s);
+    emit_fetch_int(T2, ACC, s);
+  }
 
   emit_load_bool(ACC, truebool, s);
   emit_blt(T1, T2, labelCounter, s);
@@ -1405,14 +2180,13 @@ void lt_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int fra
   emit_label_def(labelCounter++, s);
 }
 
-void eq_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void eq_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
   e1->code(s, nd, class_tab, frame_height);
-  emit_push(ACC, s);
-  e2->code(s, nd, class_tab, frame_height + 1);
+  Register temp = temp_helpers::save_acc(e2->call_free(nd, class_tab), s, class_tab, frame_height);
+  e2->code(s, nd, class_tab, frame_height);
   emit_move(T2, ACC, s);
-  emit_load(T1, 1, SP, s);
-  emit_addiu(SP, SP, WORD_SIZE, s);
+  temp_helpers::restore(T1, temp, s, class_tab, frame_height);
 
   emit_load_bool(ACC, truebool, s);
   emit_beq(T1, T2, labelCounter, s);
@@ -1422,16 +2196,23 @@ void eq_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int fra
   emit_label_def(labelCounter++, s);
 }
 
-void leq_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void leq_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
-  e1->code(s, nd, class_tab, frame_height);
-  emit_push(ACC, s);
-  e2->code(s, nd, class_tab, frame_height + 1);
-  emit_load(T1, 1, SP, s);
-  emit_addiu(SP, SP, WORD_SIZE, s);
+  if (cgen_optimize)
+  {
+    arith_helpers::emit_raw_operands(e1, e2, s, nd, class_tab, frame_height);
+  }
+  else
+  {
+    e1->code(s, nd, class_tab, frame_height);
+    emit_push(ACC, s);
+    e2->code(s, nd, class_tab, frame_height + 1);
+    emit_load(T1, 1, SP, s);
+    emit_addiu(SP, SP, WORD_SIZE, s);
 
-  emit_fetch_int(T1, T1, s);
-  emit_fetch_int(T2, ACC, s);
+    emit_fetch_int(T1, T1, s);
+    emit_fetch_int(T2, ACC, s);
+  }
 
   emit_load_bool(ACC, truebool, s);
   emit_bleq(T1, T2, labelCounter, s);
@@ -1440,7 +2221,7 @@ void leq_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int fr
   emit_label_def(labelCounter++, s);
 }
 
-void comp_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void comp_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
   e1->code(s, nd, class_tab, frame_height);
 
@@ -1452,27 +2233,36 @@ void comp_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int f
   emit_label_def(labelCounter++, s);
 }
 
-void int_const_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void int_const_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
   emit_load_int(ACC, inttable.lookup_string(token->get_string()), s);
 }
 
-void string_const_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void int_const_class::code_int(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+{
+  emit_load_imm(ACC, atoi(token->get_string()), s);
+}
+
+void string_const_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
   emit_load_string(ACC, stringtable.lookup_string(token->get_string()), s);
 }
 
-void bool_const_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void bool_const_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
   emit_load_bool(ACC, BoolConst(val), s);
 }
 
-void new__class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+//
+// Objects that escape analysis keeps inside a let are built by
+// let_class::code instead; every other new allocates in the heap.
+//
+void new__class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
   Symbol t = get_type();
   if (t == SELF_TYPE)
   {
-    s << LA << T1 << " " << CLASSOBJTAB << std::endl;
+    emit_load_address(T1, CLASSOBJTAB, s);
     emit_load(T2, 0, SELF, s);
     emit_sll(T2, T2, 3, s);
     emit_addu(T1, T1, T2, s);
@@ -1480,7 +2270,7 @@ void new__class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int f
     emit_push(T1, s);
 
     emit_load(ACC, 0, T1, s);
-    s << JAL << Object << METHOD_SEP << ::copy << endl;
+    emit_jal(method_ref(Object, ::copy), s);
 
     emit_load(T1, 1, SP, s);
     emit_addiu(SP, SP, 4, s);
@@ -1490,12 +2280,12 @@ void new__class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int f
     return;
   }
 
-  s << LA << ACC << " " << t << PROTOBJ_SUFFIX << std::endl;
-  s << JAL << Object << METHOD_SEP << ::copy << endl;
-  s << JAL << t << CLASSINIT_SUFFIX << endl;
+  emit_load_address(ACC, protobj_ref(t), s);
+  emit_jal(method_ref(Object, ::copy), s);
+  emit_jal(init_ref(t), s);
 }
 
-void isvoid_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void isvoid_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
 {
   e1->code(s, nd, class_tab, frame_height);
 
@@ -1508,20 +2298,1540 @@ void isvoid_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int
   emit_label_def(labelCounter++, s);
 }
 
-void no_expr_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+//
+// code_branch evaluates a Bool expression straight into control flow:
+// it branches to label when the value is when, and falls through
+// otherwise.  Comparisons become a single branch on the raw operands
+// and no Bool object is loaded.  Used for conditions under -O.
+//
+void Expression_class::code_branch(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height, Boolean when, int label)
+{
+  code(s, nd, class_tab, frame_height);
+  emit_load(T1, DEFAULT_OBJFIELDS, ACC, s);
+  if (when)
+    emit_bne(T1, ZERO, label, s);
+  else
+    emit_beqz(T1, label, s);
+}
+
+void lt_class::code_branch(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height, Boolean when, int label)
 {
-  /* no implementation necessary */
+  arith_helpers::emit_raw_operands(e1, e2, s, nd, class_tab, frame_height);
+  if (when)
+    emit_blt(T1, T2, label, s);
+  else
+    emit_bleq(T2, T1, label, s);
 }
 
-void object_class::code(ostream &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+void leq_class::code_branch(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height, Boolean when, int label)
 {
-  if (name == self)
+  arith_helpers::emit_raw_operands(e1, e2, s, nd, class_tab, frame_height);
+  if (when)
+    emit_bleq(T1, T2, label, s);
+  else
+    emit_blt(T2, T1, label, s);
+}
+
+//
+// Objects of a type that can never hold an Int, Bool or String are
+// equal only if they are the same object.  Int and Bool operands are
+// compared by value; String comparisons still go through equality_test.
+//
+void eq_class::code_branch(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height, Boolean when, int label)
+{
+  Symbol t1 = e1->get_type();
+  Symbol t2 = e2->get_type();
+
+  if (t1 == Int && t2 == Int)
   {
-    emit_move(ACC, SELF, s);
+    arith_helpers::emit_raw_operands(e1, e2, s, nd, class_tab, frame_height);
+  }
+  else if (t1 == Bool || (t1 != Object && t2 != Object &&
+                          !symbol_flags.test(t1, SYM_BASIC_VALUE) && !symbol_flags.test(t2, SYM_BASIC_VALUE)))
+  {
+    e1->code(s, nd, class_tab, frame_height);
+    Register temp = temp_helpers::save_acc(e2->call_free(nd, class_tab), s, class_tab, frame_height);
+    e2->code(s, nd, class_tab, frame_height);
+    emit_move(T2, ACC, s);
+    temp_helpers::restore(T1, temp, s, class_tab, frame_height);
+
+    if (t1 == Bool)
+    {
+      emit_fetch_int(T1, T1, s);
+      emit_fetch_int(T2, T2, s);
+    }
   }
   else
   {
-    Variable *cur = nd->variables.lookup(name);
-    emit_load(ACC, cur->offset, cur->reg, s);
+    Expression_class::code_branch(s, nd, class_tab, frame_height, when, label);
+    return;
   }
+
+  if (when)
+    emit_beq(T1, T2, label, s);
+  else
+    emit_bne(T1, T2, label, s);
+}
+
+void comp_class::code_branch(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height, Boolean when, int label)
+{
+  e1->code_branch(s, nd, class_tab, frame_height, !when, label);
+}
+
+void isvoid_class::code_branch(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height, Boolean when, int label)
+{
+  e1->code(s, nd, class_tab, frame_height);
+  if (when)
+    emit_beqz(ACC, label, s);
+  else
+    emit_bne(ACC, ZERO, label, s);
+}
+
+void bool_const_class::code_branch(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height, Boolean when, int label)
+{
+  if (val == when)
+    emit_branch(label, s);
+}
+
+void no_expr_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+{
+  /* no implementation necessary */
+}
+
+void object_class::code(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+{
+  if (name == self)
+  {
+    emit_move(ACC, SELF, s);
+  }
+  else
+  {
+    Variable *cur = nd->variables.lookup(name);
+    if (cur->raw)
+    {
+      emit_new_int(s);
+      emit_load(T1, cur->offset, cur->reg, s);
+      emit_store_int(T1, ACC, s);
+    }
+    else
+    {
+      emit_load(ACC, cur->offset, cur->reg, s);
+    }
+  }
+}
+
+void object_class::code_int(MipsCode &s, CgenNodeP nd, CgenClassTableP class_tab, int frame_height)
+{
+  Variable *cur = nd->variables.lookup(name);
+  if (cur->raw)
+    emit_load(ACC, cur->offset, cur->reg, s);
+  else
+    Expression_class::code_int(s, nd, class_tab, frame_height);
+}
+
+///////////////////////////////////////////////////////////////////////
+//
+// Frame use
+//
+///////////////////////////////////////////////////////////////////////
+
+//
+// Only formals and attributes are bound while a body is scanned, so a
+// name with no binding is a let variable, and any let marks the frame
+// as used.  A let that shadows an attribute only makes the result more
+// conservative.
+//
+static void note_variable(Symbol name, CgenNodeP nd, FrameUse &use)
+{
+  if (name == self)
+  {
+    use.self = true;
+    return;
+  }
+
+  if (Variable *v = nd->variables.lookup(name))
+  {
+    if (v->reg == SELF)
+      use.self = true;
+    else
+      use.fp = true;
+  }
+}
+
+void object_class::frame_use(CgenNodeP nd, FrameUse &use)
+{
+  note_variable(name, nd, use);
+}
+
+void assign_class::frame_use(CgenNodeP nd, FrameUse &use)
+{
+  note_variable(name, nd, use);
+  expr->frame_use(nd, use);
+}
+
+void let_class::frame_use(CgenNodeP nd, FrameUse &use)
+{
+  use.fp = true;
+  init->frame_use(nd, use);
+  body->frame_use(nd, use);
+}
+
+void typcase_class::frame_use(CgenNodeP nd, FrameUse &use)
+{
+  use.fp = true;
+  Expression_class::frame_use(nd, use);
+}
+
+///////////////////////////////////////////////////////////////////////
+//
+// Slot depth
+//
+///////////////////////////////////////////////////////////////////////
+
+//
+// slot_depth is the largest number of let and case variables in scope
+// at once: how many slots a method's frame reserves for them.  A let
+// whose object lives in the frame also holds its fields and eyecatcher.
+//
+int let_class::slot_depth(CgenClassTableP class_tab)
+{
+  auto object = class_tab->stack_objects.find(this);
+  int object_slots = object == class_tab->stack_objects.end() ? 0 : object->second + 1;
+  return std::max(init->slot_depth(class_tab), object_slots + 1 + body->slot_depth(class_tab));
+}
+
+int typcase_class::slot_depth(CgenClassTableP class_tab)
+{
+  int depth = expr->slot_depth(class_tab);
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+    depth = std::max(depth, 1 + cases->nth(i)->get_expr()->slot_depth(class_tab));
+  return depth;
+}
+
+///////////////////////////////////////////////////////////////////////
+//
+// Tail calls
+//
+///////////////////////////////////////////////////////////////////////
+
+//
+// mark_tail_calls walks the tail positions of the body of method and
+// records in tail_calls the dispatches on self there that can only run
+// method itself.  It returns whether it found any.
+//
+Boolean static_dispatch_class::mark_tail_calls(Feature method, CgenNodeP nd, CgenClassTableP class_tab)
+{
+  if (expr->variable_name() != self)
+    return false;
+
+  CgenNodeP static_class = class_tab->lookup(type_name);
+  if (static_class->methods[static_class->method_slots.at(name)].nd != method)
+    return false;
+
+  class_tab->tail_calls.insert(this);
+  return true;
+}
+
+Boolean dispatch_class::mark_tail_calls(Feature method, CgenNodeP nd, CgenClassTableP class_tab)
+{
+  if (expr->variable_name() != self)
+    return false;
+
+  // A subclass that overrides method would run its own version.
+  int slot = nd->method_slots.at(name);
+  if (!nd->slot_targets[slot] || nd->methods[slot].nd != method)
+    return false;
+
+  class_tab->tail_calls.insert(this);
+  return true;
+}
+
+Boolean cond_class::mark_tail_calls(Feature method, CgenNodeP nd, CgenClassTableP class_tab)
+{
+  Boolean in_then = then_exp->mark_tail_calls(method, nd, class_tab);
+  Boolean in_else = else_exp->mark_tail_calls(method, nd, class_tab);
+  return in_then || in_else;
+}
+
+Boolean typcase_class::mark_tail_calls(Feature method, CgenNodeP nd, CgenClassTableP class_tab)
+{
+  Boolean found = false;
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+    found = cases->nth(i)->get_expr()->mark_tail_calls(method, nd, class_tab) || found;
+  return found;
+}
+
+Boolean block_class::mark_tail_calls(Feature method, CgenNodeP nd, CgenClassTableP class_tab)
+{
+  return body->nth(body->len() - 1)->mark_tail_calls(method, nd, class_tab);
+}
+
+Boolean let_class::mark_tail_calls(Feature method, CgenNodeP nd, CgenClassTableP class_tab)
+{
+  return body->mark_tail_calls(method, nd, class_tab);
+}
+
+///////////////////////////////////////////////////////////////////////
+//
+// Inlining
+//
+///////////////////////////////////////////////////////////////////////
+
+// Enough for getters, setters and wrappers around an arithmetic expression.
+static const int DEFAULT_INLINE_BUDGET = 10;
+
+Inliner::Inliner() : budget(DEFAULT_INLINE_BUDGET), report(getenv("COOL_INLINE_REPORT") != nullptr)
+{
+  if (const char *b = getenv("COOL_INLINE_BUDGET"))
+    budget = atoi(b);
+}
+
+// Number of nodes in e, or -1 if it contains a dispatch.
+static int expression_size(Expression e)
+{
+  if (e->is_dispatch())
+    return -1;
+
+  ExprList ls;
+  e->children(ls);
+
+  int size = 1;
+  for (Expression child : ls)
+  {
+    int n = expression_size(child);
+    if (n < 0)
+      return -1;
+    size += n;
+  }
+  return size;
+}
+
+int Inliner::body_size(Feature method)
+{
+  auto it = sizes.find(method);
+  if (it != sizes.end())
+    return it->second;
+
+  return sizes[method] = expression_size(method->get_expr());
+}
+
+Boolean Inliner::should_inline(CgenNodeP caller, int line, CgenNodeP owner, const Method &method)
+{
+  if (budget <= 0 || owner->basic())
+    return false;
+
+  int size = body_size(method.nd);
+  Boolean inlined = size >= 0 && size <= budget;
+
+  if (report)
+  {
+    std::cerr << caller->get_filename() << ":" << line << ": "
+              << (inlined ? "inlined " : "not inlined ") << method.class_name << "." << method.nd->get_name();
+    if (size < 0)
+      std::cerr << ": it dispatches";
+    else if (!inlined)
+      std::cerr << ": size " << size << " over budget " << budget;
+    else
+      std::cerr << ", size " << size;
+    std::cerr << "\n";
+  }
+
+  return inlined;
+}
+
+///////////////////////////////////////////////////////////////////////
+//
+// Reachability
+//
+///////////////////////////////////////////////////////////////////////
+
+void Reachability::make_live(CgenNodeP nd)
+{
+  for (; nd && !nd->live; nd = nd->get_parentnd())
+  {
+    nd->live = true;
+
+    Features f = nd->get_features();
+    for (int i = f->first(); f->more(i); i = f->next(i))
+      if (f->nth(i)->is_attr())
+        worklist.emplace_back(nd, f->nth(i)->get_expr());
+  }
+}
+
+void Reachability::instantiate(CgenNodeP nd)
+{
+  if (!instantiated.insert(nd).second)
+    return;
+
+  make_live(nd);
+
+  // Dispatches seen before nd was instantiated may now land in it.
+  for (CgenNodeP cur = nd; cur; cur = cur->get_parentnd())
+  {
+    auto it = sites.find(cur);
+    if (it == sites.end())
+      continue;
+
+    for (int slot : it->second)
+      reach_method(nd, slot);
+  }
+}
+
+void Reachability::reach_method(CgenNodeP nd, int slot)
+{
+  const Method &method = nd->methods[slot];
+  if (!class_tab->live_methods.insert(method.nd).second)
+    return;
+
+  CgenNodeP owner = class_tab->lookup(method.class_name);
+  make_live(owner);
+  worklist.emplace_back(owner, method.nd->get_expr());
+}
+
+void Reachability::reach_instances(CgenNodeP nd, int slot)
+{
+  if (instantiated.count(nd))
+    reach_method(nd, slot);
+
+  for (auto &child : nd->get_children())
+    reach_instances(child, slot);
+}
+
+void Reachability::dispatch(CgenNodeP static_class, int slot)
+{
+  if (!sites[static_class].insert(slot).second)
+    return;
+
+  // Devirtualized call sites jump straight to the unique implementation.
+  if (static_class->slot_targets[slot])
+    reach_method(static_class, slot);
+
+  reach_instances(static_class, slot);
+}
+
+void Reachability::run()
+{
+  // The runtime creates objects of the basic classes on its own.
+  for (const BasicClassInfo &info : basic_class_info)
+    instantiate(class_tab->lookup(basic_symbols[info.name]));
+
+  CgenNodeP main_class = class_tab->lookup(Main);
+  instantiate(main_class);
+  reach_method(main_class, main_class->method_slots.at(main_meth));
+
+  while (!worklist.empty())
+  {
+    auto item = worklist.back();
+    worklist.pop_back();
+    item.second->reach(*this, item.first);
+  }
+}
+
+void static_dispatch_class::reach(Reachability &r, CgenNodeP nd)
+{
+  CgenNodeP static_class = r.get_class_table()->lookup(type_name);
+  r.make_live(static_class);
+  r.reach_method(static_class, static_class->method_slots.at(name));
+
+  Expression_class::reach(r, nd);
+}
+
+void dispatch_class::reach(Reachability &r, CgenNodeP nd)
+{
+  CgenClassTableP class_tab = r.get_class_table();
+  CgenNodeP static_class = class_tab->lookup((expr->get_type() == SELF_TYPE) ? nd->get_name() : expr->get_type());
+  r.dispatch(static_class, static_class->method_slots.at(name));
+
+  Expression_class::reach(r, nd);
+}
+
+void new__class::reach(Reachability &r, CgenNodeP nd)
+{
+  // new SELF_TYPE copies the prototype of an object that already exists.
+  if (type_name != SELF_TYPE)
+    r.instantiate(r.get_class_table()->lookup(type_name));
+}
+
+//
+// children() lists the direct subexpressions of a node, for analyses that
+// only need to walk the tree.
+//
+static void push_list(Expressions ls, ExprList &out)
+{
+  for (int i = ls->first(); ls->more(i); i = ls->next(i))
+    out.push_back(ls->nth(i));
+}
+
+void assign_class::children(ExprList &out) { out.push_back(expr); }
+
+void static_dispatch_class::children(ExprList &out)
+{
+  out.push_back(expr);
+  push_list(actual, out);
+}
+
+void dispatch_class::children(ExprList &out)
+{
+  out.push_back(expr);
+  push_list(actual, out);
+}
+
+void cond_class::children(ExprList &out)
+{
+  out.push_back(pred);
+  out.push_back(then_exp);
+  out.push_back(else_exp);
+}
+
+void loop_class::children(ExprList &out)
+{
+  out.push_back(pred);
+  out.push_back(body);
+}
+
+void typcase_class::children(ExprList &out)
+{
+  out.push_back(expr);
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+    out.push_back(cases->nth(i)->get_expr());
+}
+
+void block_class::children(ExprList &out) { push_list(body, out); }
+
+void let_class::children(ExprList &out)
+{
+  out.push_back(init);
+  out.push_back(body);
+}
+
+void plus_class::children(ExprList &out)
+{
+  out.push_back(e1);
+  out.push_back(e2);
+}
+
+void sub_class::children(ExprList &out)
+{
+  out.push_back(e1);
+  out.push_back(e2);
+}
+
+void mul_class::children(ExprList &out)
+{
+  out.push_back(e1);
+  out.push_back(e2);
+}
+
+void divide_class::children(ExprList &out)
+{
+  out.push_back(e1);
+  out.push_back(e2);
+}
+
+void neg_class::children(ExprList &out) { out.push_back(e1); }
+
+void lt_class::children(ExprList &out)
+{
+  out.push_back(e1);
+  out.push_back(e2);
+}
+
+void eq_class::children(ExprList &out)
+{
+  out.push_back(e1);
+  out.push_back(e2);
+}
+
+void leq_class::children(ExprList &out)
+{
+  out.push_back(e1);
+  out.push_back(e2);
+}
+
+void comp_class::children(ExprList &out) { out.push_back(e1); }
+void int_const_class::children(ExprList &out) {}
+void bool_const_class::children(ExprList &out) {}
+void string_const_class::children(ExprList &out) {}
+void new__class::children(ExprList &out) {}
+void isvoid_class::children(ExprList &out) { out.push_back(e1); }
+void no_expr_class::children(ExprList &out) {}
+void object_class::children(ExprList &out) {}
+
+///////////////////////////////////////////////////////////////////////
+//
+// Nullness
+//
+///////////////////////////////////////////////////////////////////////
+
+//
+// Int, Bool and String values are never void: their variables start out
+// as 0, false and "" and only values of the same type can be assigned.
+//
+Boolean Nullness::basic_value(Symbol type)
+{
+  return symbol_flags.test(type, SYM_BASIC_VALUE);
+}
+
+//
+// The basic methods declared to return SELF_TYPE (copy, out_string,
+// out_int) return the receiver or a copy of it.
+//
+Boolean Nullness::returns_receiver(const Method &method)
+{
+  return symbol_flags.test(method.class_name, SYM_BASIC_CLASS) && method.nd->get_ret() == SELF_TYPE;
+}
+
+void Nullness::set(Symbol name, Boolean non_void)
+{
+  if (non_void)
+    facts.insert(name);
+  else
+    facts.erase(name);
+}
+
+//
+// Dispatch and case abort on a void receiver, so a variable used as one
+// is non-void from then on.
+//
+void Nullness::checked(Expression receiver)
+{
+  Symbol name = receiver->variable_name();
+  if (name && name != self)
+    facts.insert(name);
+}
+
+void Nullness::call()
+{
+  for (auto it = facts.begin(); it != facts.end();)
+  {
+    auto local = locals.find(*it);
+    if (local == locals.end() || !local->second)
+      it = facts.erase(it);
+    else
+      ++it;
+  }
+}
+
+void Nullness::meet(const Facts &other)
+{
+  for (auto it = facts.begin(); it != facts.end();)
+  {
+    if (other.count(*it))
+      ++it;
+    else
+      it = facts.erase(it);
+  }
+}
+
+void Nullness::mark(Expression site)
+{
+  if (marking)
+    class_tab->non_void_receivers.insert(site);
+}
+
+Boolean Nullness::suspend_marks()
+{
+  Boolean previous = marking;
+  marking = false;
+  return previous;
+}
+
+void Nullness::resume_marks(Boolean previous)
+{
+  marking = previous;
+}
+
+Boolean Nullness::bind(Symbol name, Boolean non_void)
+{
+  Boolean outer = facts.count(name);
+  locals[name]++;
+  set(name, non_void);
+  return outer;
+}
+
+void Nullness::unbind(Symbol name, Boolean outer)
+{
+  // A shadowed attribute may have been assigned by a call made while the
+  // local was in scope.
+  locals[name]--;
+  set(name, outer && locals[name] > 0);
+}
+
+Boolean Expression_class::non_void(Nullness &n)
+{
+  ExprList ls;
+  children(ls);
+  for (Expression e : ls)
+    e->non_void(n);
+
+  return n.basic_value(get_type());
+}
+
+Boolean assign_class::non_void(Nullness &n)
+{
+  Boolean result = expr->non_void(n);
+  n.set(name, result);
+  return result;
+}
+
+Boolean static_dispatch_class::non_void(Nullness &n)
+{
+  for (int i = actual->first(); actual->more(i); i = actual->next(i))
+    actual->nth(i)->non_void(n);
+
+  if (expr->non_void(n))
+    n.mark(this);
+
+  // The callee may assign an attribute receiver, so the check only
+  // survives the call for locals.
+  n.checked(expr);
+  n.call();
+
+  CgenNodeP static_class = n.get_class_table()->lookup(type_name);
+  const Method &method = static_class->methods[static_class->method_slots.at(name)];
+  return n.basic_value(get_type()) || n.returns_receiver(method);
+}
+
+Boolean dispatch_class::non_void(Nullness &n)
+{
+  for (int i = actual->first(); actual->more(i); i = actual->next(i))
+    actual->nth(i)->non_void(n);
+
+  if (expr->non_void(n))
+    n.mark(this);
+
+  // The callee may assign an attribute receiver, so the check only
+  // survives the call for locals.
+  n.checked(expr);
+  n.call();
+
+  CgenNodeP static_class = n.get_class_table()->lookup((expr->get_type() == SELF_TYPE) ? n.get_class()->get_name() : expr->get_type());
+  int slot = static_class->method_slots.at(name);
+  return n.basic_value(get_type()) ||
+         (static_class->slot_targets[slot] && n.returns_receiver(static_class->methods[slot]));
+}
+
+Boolean cond_class::non_void(Nullness &n)
+{
+  pred->non_void(n);
+  Nullness::Facts else_facts = n.facts;
+
+  Boolean result = then_exp->non_void(n);
+  Nullness::Facts then_facts = n.facts;
+
+  n.facts = else_facts;
+  result = else_exp->non_void(n) && result;
+  n.meet(then_facts);
+
+  return result;
+}
+
+//
+// The facts at the loop head have to survive every iteration, so they
+// are narrowed until the body no longer removes any before receivers
+// are marked.
+//
+Boolean loop_class::non_void(Nullness &n)
+{
+  Boolean marking = n.suspend_marks();
+  size_t before;
+  do
+  {
+    before = n.facts.size();
+    Nullness::Facts head = n.facts;
+    pred->non_void(n);
+    body->non_void(n);
+    n.meet(head);
+  } while (n.facts.size() != before);
+  n.resume_marks(marking);
+
+  pred->non_void(n);
+  Nullness::Facts exit_facts = n.facts;
+  body->non_void(n);
+  n.facts = exit_facts;
+
+  return false;
+}
+
+Boolean typcase_class::non_void(Nullness &n)
+{
+  if (expr->non_void(n))
+    n.mark(this);
+  n.checked(expr);
+
+  Nullness::Facts before = n.facts;
+  Nullness::Facts after = before;
+  Boolean result = true;
+
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+  {
+    Case c = cases->nth(i);
+    n.facts = before;
+
+    // The branch variable holds the object that matched.
+    Boolean outer = n.bind(c->get_name(), true);
+    result = c->get_expr()->non_void(n) && result;
+    n.unbind(c->get_name(), outer);
+
+    if (i != cases->first())
+      n.meet(after);
+    after = n.facts;
+  }
+
+  n.facts = after;
+  return result;
+}
+
+Boolean block_class::non_void(Nullness &n)
+{
+  Boolean result = false;
+  for (int i = body->first(); body->more(i); i = body->next(i))
+    result = body->nth(i)->non_void(n);
+
+  return result;
+}
+
+Boolean let_class::non_void(Nullness &n)
+{
+  Boolean init_non_void = init->is_no_expr() ? n.basic_value(type_decl) : init->non_void(n);
+
+  Boolean outer = n.bind(identifier, init_non_void);
+  Boolean result = body->non_void(n);
+  n.unbind(identifier, outer);
+
+  return result;
+}
+
+// T_init only sees the new object, so it cannot assign our attributes.
+Boolean new__class::non_void(Nullness &n) { return true; }
+
+Boolean object_class::non_void(Nullness &n)
+{
+  return name == self || n.facts.count(name) || n.basic_value(get_type());
+}
+
+///////////////////////////////////////////////////////////////////////
+//
+// Unboxing
+//
+///////////////////////////////////////////////////////////////////////
+
+void Unboxing::bind(Symbol name, Expression let)
+{
+  scopes[name].push_back(let);
+  if (let)
+    candidates.push_back(let);
+}
+
+void Unboxing::unbind(Symbol name)
+{
+  scopes[name].pop_back();
+}
+
+Boolean Unboxing::is_candidate(Symbol name)
+{
+  auto scope = scopes.find(name);
+  return scope != scopes.end() && !scope->second.empty() && scope->second.back();
+}
+
+// A use that needs an object would have to box the value every time.
+void Unboxing::use(Symbol name, Boolean int_context)
+{
+  if (!int_context && is_candidate(name))
+    boxed.insert(scopes[name].back());
+}
+
+void Unboxing::discard(Expression e)
+{
+  class_tab->unused_values.insert(e);
+}
+
+void Unboxing::finish()
+{
+  for (Expression let : candidates)
+    if (!boxed.count(let))
+      class_tab->unboxed_lets.insert(let);
+}
+
+void Expression_class::plan_unboxing(Unboxing &u, Boolean int_context)
+{
+  ExprList ls;
+  children(ls);
+  for (Expression e : ls)
+    e->plan_unboxing(u, false);
+}
+
+void plus_class::plan_unboxing(Unboxing &u, Boolean int_context)
+{
+  e1->plan_unboxing(u, true);
+  e2->plan_unboxing(u, true);
+}
+
+void sub_class::plan_unboxing(Unboxing &u, Boolean int_context)
+{
+  e1->plan_unboxing(u, true);
+  e2->plan_unboxing(u, true);
+}
+
+void mul_class::plan_unboxing(Unboxing &u, Boolean int_context)
+{
+  e1->plan_unboxing(u, true);
+  e2->plan_unboxing(u, true);
+}
+
+void divide_class::plan_unboxing(Unboxing &u, Boolean int_context)
+{
+  e1->plan_unboxing(u, true);
+  e2->plan_unboxing(u, true);
+}
+
+void neg_class::plan_unboxing(Unboxing &u, Boolean int_context)
+{
+  e1->plan_unboxing(u, true);
+}
+
+void lt_class::plan_unboxing(Unboxing &u, Boolean int_context)
+{
+  e1->plan_unboxing(u, true);
+  e2->plan_unboxing(u, true);
+}
+
+void leq_class::plan_unboxing(Unboxing &u, Boolean int_context)
+{
+  e1->plan_unboxing(u, true);
+  e2->plan_unboxing(u, true);
+}
+
+void assign_class::plan_unboxing(Unboxing &u, Boolean int_context)
+{
+  expr->plan_unboxing(u, u.is_candidate(name));
+}
+
+void loop_class::plan_unboxing(Unboxing &u, Boolean int_context)
+{
+  pred->plan_unboxing(u, false);
+  body->plan_unboxing(u, false);
+  u.discard(body);
+}
+
+void block_class::plan_unboxing(Unboxing &u, Boolean int_context)
+{
+  for (int i = body->first(); body->more(i); i = body->next(i))
+  {
+    Boolean last = !body->more(body->next(i));
+    body->nth(i)->plan_unboxing(u, last && int_context);
+    if (!last)
+      u.discard(body->nth(i));
+  }
+}
+
+void let_class::plan_unboxing(Unboxing &u, Boolean int_context)
+{
+  init->plan_unboxing(u, type_decl == Int);
+
+  u.bind(identifier, type_decl == Int ? this : NULL);
+  body->plan_unboxing(u, int_context);
+  u.unbind(identifier);
+}
+
+void object_class::plan_unboxing(Unboxing &u, Boolean int_context)
+{
+  u.use(name, int_context);
+}
+
+///////////////////////////////////////////////////////////////////////
+//
+// Escape analysis
+//
+// escapes says whether the object bound to var may outlive the let that
+// holds it.  value_used is false where the value of the expression is
+// discarded, so a variable there carries nothing.  The summaries of
+// the methods of cls start out optimistic and grow until a whole pass
+// over the let body changes none of them.
+//
+///////////////////////////////////////////////////////////////////////
+
+Boolean Escape::new_escapes(CgenNodeP cls, Symbol var, Expression body)
+{
+  this->cls = cls;
+  summaries.clear();
+
+  Boolean result;
+  do
+  {
+    changed = false;
+    visited.clear();
+    result = init_escapes() || body->escapes(*this, var, true);
+  } while (changed);
+
+  return result;
+}
+
+// The attribute initializers of cls and its ancestors run on the object.
+Boolean Escape::init_escapes()
+{
+  for (CgenNodeP nd = cls; nd; nd = nd->get_parentnd())
+  {
+    Features f = nd->get_features();
+    for (int i = f->first(); f->more(i); i = f->next(i))
+      if (f->nth(i)->is_attr() && f->nth(i)->get_expr()->escapes(*this, self, true))
+        return true;
+  }
+  return false;
+}
+
+Escape::Summary Escape::summary(const Method &method)
+{
+  Summary &known = summaries[method.nd];
+  if (!visited.insert(method.nd).second)
+    return known;
+
+  Summary now = analyze(method);
+  if (now.escapes != known.escapes || now.returns_self != known.returns_self)
+  {
+    known = now;
+    changed = true;
+  }
+  return now;
+}
+
+// The basic methods keep no pointer to self; those declared to return
+// SELF_TYPE, except copy, return it.
+Escape::Summary Escape::analyze(const Method &method)
+{
+  Summary result = {false, false};
+  if (symbol_flags.test(method.class_name, SYM_BASIC_CLASS))
+  {
+    result.returns_self = method.nd->get_ret() == SELF_TYPE && method.nd->get_name() != ::copy;
+    return result;
+  }
+
+  Expression body = method.nd->get_expr();
+  if (body->escapes(*this, self, false))
+    result.escapes = result.returns_self = true;
+  else
+    result.returns_self = body->escapes(*this, self, true);
+  return result;
+}
+
+Boolean Expression_class::escapes(Escape &e, Symbol var, Boolean value_used)
+{
+  ExprList ls;
+  children(ls);
+  for (Expression c : ls)
+    if (c->escapes(e, var, true))
+      return true;
+  return false;
+}
+
+Boolean object_class::escapes(Escape &e, Symbol var, Boolean value_used)
+{
+  return value_used && name == var;
+}
+
+Boolean assign_class::escapes(Escape &e, Symbol var, Boolean value_used)
+{
+  return expr->escapes(e, var, true);
+}
+
+namespace escape_helpers
+{
+  Boolean actuals_escape(Expressions actual, Escape &e, Symbol var)
+  {
+    for (int i = actual->first(); actual->more(i); i = actual->next(i))
+      if (actual->nth(i)->escapes(e, var, true))
+        return true;
+    return false;
+  }
+
+  Boolean call_escapes(Escape &e, CgenNodeP static_class, Symbol name, Boolean value_used)
+  {
+    Escape::Summary callee = e.summary(static_class->methods[static_class->method_slots.at(name)]);
+    return callee.escapes || (value_used && callee.returns_self);
+  }
+}
+
+Boolean dispatch_class::escapes(Escape &e, Symbol var, Boolean value_used)
+{
+  if (escape_helpers::actuals_escape(actual, e, var))
+    return true;
+  if (expr->variable_name() != var)
+    return expr->escapes(e, var, true);
+
+  return escape_helpers::call_escapes(e, e.get_class(), name, value_used);
+}
+
+Boolean static_dispatch_class::escapes(Escape &e, Symbol var, Boolean value_used)
+{
+  if (escape_helpers::actuals_escape(actual, e, var))
+    return true;
+  if (expr->variable_name() != var)
+    return expr->escapes(e, var, true);
+
+  return escape_helpers::call_escapes(e, e.get_class_table()->lookup(type_name), name, value_used);
+}
+
+Boolean cond_class::escapes(Escape &e, Symbol var, Boolean value_used)
+{
+  return pred->escapes(e, var, false) || then_exp->escapes(e, var, value_used) ||
+         else_exp->escapes(e, var, value_used);
+}
+
+Boolean loop_class::escapes(Escape &e, Symbol var, Boolean value_used)
+{
+  return pred->escapes(e, var, false) || body->escapes(e, var, false);
+}
+
+Boolean typcase_class::escapes(Escape &e, Symbol var, Boolean value_used)
+{
+  if (expr->escapes(e, var, true))
+    return true;
+
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+  {
+    Case c = cases->nth(i);
+    if (c->get_name() != var && c->get_expr()->escapes(e, var, value_used))
+      return true;
+  }
+  return false;
+}
+
+Boolean block_class::escapes(Escape &e, Symbol var, Boolean value_used)
+{
+  for (int i = body->first(); body->more(i); i = body->next(i))
+  {
+    Boolean last = !body->more(body->next(i));
+    if (body->nth(i)->escapes(e, var, last && value_used))
+      return true;
+  }
+  return false;
+}
+
+Boolean let_class::escapes(Escape &e, Symbol var, Boolean value_used)
+{
+  return init->escapes(e, var, true) || (identifier != var && body->escapes(e, var, value_used));
+}
+
+Boolean eq_class::escapes(Escape &e, Symbol var, Boolean value_used)
+{
+  return e1->escapes(e, var, false) || e2->escapes(e, var, false);
+}
+
+Boolean isvoid_class::escapes(Escape &e, Symbol var, Boolean value_used)
+{
+  return e1->escapes(e, var, false);
+}
+
+void Expression_class::plan_stack_objects(Escape &e)
+{
+  ExprList ls;
+  children(ls);
+  for (Expression c : ls)
+    c->plan_stack_objects(e);
+}
+
+// new SELF_TYPE picks its class at run time, and Int, Bool and String
+// objects are left to the heap.
+void let_class::plan_stack_objects(Escape &e)
+{
+  Symbol t = init->get_type();
+  if (init->is_new() && !symbol_flags.test(t, SYM_SELF_TYPE) && !symbol_flags.test(t, SYM_BASIC_VALUE))
+  {
+    CgenClassTableP class_tab = e.get_class_table();
+    CgenNodeP cls = class_tab->lookup(t);
+    if (!e.new_escapes(cls, identifier, body))
+      class_tab->stack_objects[this] = DEFAULT_OBJFIELDS + cls->attributes.current_scope().size();
+  }
+
+  Expression_class::plan_stack_objects(e);
+}
+
+///////////////////////////////////////////////////////////////////////
+//
+// Constant folding
+//
+// fold() folds the children of a node, then returns the expression that
+// replaces the node: a new constant, one of its children, or the node
+// itself.  add, sub and neg trap on overflow and div traps on zero or
+// INT_MIN / -1, so those operations are left for run time; mul does not
+// trap and its product wraps at 32 bits.
+//
+///////////////////////////////////////////////////////////////////////
+
+namespace fold_helpers
+{
+  Expression int_result(int value)
+  {
+    return int_const(inttable.add_int(value))->set_type(Int);
+  }
+
+  Expression bool_result(Boolean value)
+  {
+    return bool_const(value)->set_type(Bool);
+  }
+
+  Boolean fits(long long value)
+  {
+    return value >= INT_MIN && value <= INT_MAX;
+  }
+
+  Boolean is_int(Expression e, int value)
+  {
+    int v;
+    return e->int_value(v) && v == value;
+  }
+
+  // Expressions that can be dropped when their value is not used.
+  Boolean is_pure(Expression e)
+  {
+    return e->is_literal() || e->variable_name() || e->is_no_expr();
+  }
+
+  Expressions fold_all(Expressions ls)
+  {
+    Expressions folded = nil_Expressions();
+    for (int i = ls->first(); ls->more(i); i = ls->next(i))
+      folded = append_Expressions(folded, single_Expressions(ls->nth(i)->fold()));
+    return folded;
+  }
+}
+
+Boolean int_const_class::int_value(int &value)
+{
+  value = atoi(token->get_string());
+  return true;
+}
+
+Expression assign_class::fold()
+{
+  expr = expr->fold();
+  return this;
+}
+
+Expression static_dispatch_class::fold()
+{
+  expr = expr->fold();
+  actual = fold_helpers::fold_all(actual);
+  return this;
+}
+
+Expression dispatch_class::fold()
+{
+  expr = expr->fold();
+  actual = fold_helpers::fold_all(actual);
+  return this;
+}
+
+Expression cond_class::fold()
+{
+  pred = pred->fold();
+  then_exp = then_exp->fold();
+  else_exp = else_exp->fold();
+
+  Boolean value;
+  if (pred->bool_value(value))
+    return value ? then_exp : else_exp;
+  return this;
+}
+
+// A loop that never runs keeps only its (void) value; loop_class::code
+// also drops the test of a constant predicate.
+Expression loop_class::fold()
+{
+  pred = pred->fold();
+  body = body->fold();
+
+  Boolean value;
+  if (pred->bool_value(value) && !value)
+    body = no_expr()->set_type(No_type);
+  return this;
+}
+
+void branch_class::fold()
+{
+  expr = expr->fold();
+}
+
+Expression typcase_class::fold()
+{
+  expr = expr->fold();
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+    cases->nth(i)->fold();
+  return this;
+}
+
+Expression block_class::fold()
+{
+  Expressions folded = nil_Expressions();
+  for (int i = body->first(); body->more(i); i = body->next(i))
+  {
+    Expression e = body->nth(i)->fold();
+    if (body->more(body->next(i)) && fold_helpers::is_pure(e))
+      continue;
+    folded = append_Expressions(folded, single_Expressions(e));
+  }
+
+  body = folded;
+  return body->len() == 1 ? body->nth(body->first()) : this;
+}
+
+Expression let_class::fold()
+{
+  init = init->fold();
+  body = body->fold();
+  return this;
+}
+
+Expression plus_class::fold()
+{
+  e1 = e1->fold();
+  e2 = e2->fold();
+
+  int a, b;
+  if (e1->int_value(a) && e2->int_value(b) && fold_helpers::fits((long long)a + b))
+    return fold_helpers::int_result(a + b);
+  if (fold_helpers::is_int(e2, 0))
+    return e1;
+  if (fold_helpers::is_int(e1, 0))
+    return e2;
+  return this;
+}
+
+Expression sub_class::fold()
+{
+  e1 = e1->fold();
+  e2 = e2->fold();
+
+  int a, b;
+  if (e1->int_value(a) && e2->int_value(b) && fold_helpers::fits((long long)a - b))
+    return fold_helpers::int_result(a - b);
+  if (fold_helpers::is_int(e2, 0))
+    return e1;
+  return this;
+}
+
+Expression mul_class::fold()
+{
+  e1 = e1->fold();
+  e2 = e2->fold();
+
+  int a, b;
+  if (e1->int_value(a) && e2->int_value(b))
+    return fold_helpers::int_result((int)((unsigned)a * (unsigned)b));
+  if (fold_helpers::is_int(e2, 1))
+    return e1;
+  if (fold_helpers::is_int(e1, 1))
+    return e2;
+  return this;
+}
+
+Expression divide_class::fold()
+{
+  e1 = e1->fold();
+  e2 = e2->fold();
+
+  int a, b;
+  if (e1->int_value(a) && e2->int_value(b) && b != 0 && !(a == INT_MIN && b == -1))
+    return fold_helpers::int_result(a / b);
+  if (fold_helpers::is_int(e2, 1))
+    return e1;
+  return this;
+}
+
+Expression neg_class::fold()
+{
+  e1 = e1->fold();
+
+  int a;
+  if (e1->int_value(a) && a != INT_MIN)
+    return fold_helpers::int_result(-a);
+  return this;
+}
+
+Expression lt_class::fold()
+{
+  e1 = e1->fold();
+  e2 = e2->fold();
+
+  int a, b;
+  if (e1->int_value(a) && e2->int_value(b))
+    return fold_helpers::bool_result(a < b);
+  return this;
+}
+
+Expression leq_class::fold()
+{
+  e1 = e1->fold();
+  e2 = e2->fold();
+
+  int a, b;
+  if (e1->int_value(a) && e2->int_value(b))
+    return fold_helpers::bool_result(a <= b);
+  return this;
+}
+
+Expression eq_class::fold()
+{
+  e1 = e1->fold();
+  e2 = e2->fold();
+
+  int a, b;
+  if (e1->int_value(a) && e2->int_value(b))
+    return fold_helpers::bool_result(a == b);
+
+  Boolean p, q;
+  if (e1->bool_value(p) && e2->bool_value(q))
+    return fold_helpers::bool_result(p == q);
+  return this;
+}
+
+Expression comp_class::fold()
+{
+  e1 = e1->fold();
+
+  Boolean value;
+  if (e1->bool_value(value))
+    return fold_helpers::bool_result(!value);
+  return this;
+}
+
+//
+// Constants and new objects are never void.  The initializer of a user
+// class may have side effects, so that object is still created.
+//
+Expression isvoid_class::fold()
+{
+  e1 = e1->fold();
+
+  if (e1->is_literal() || (e1->is_new() && symbol_flags.test(e1->get_type(), SYM_BASIC_CLASS)))
+    return fold_helpers::bool_result(false);
+
+  if (e1->is_new())
+  {
+    Expressions body = append_Expressions(single_Expressions(e1),
+                                          single_Expressions(fold_helpers::bool_result(false)));
+    return block(body)->set_type(Bool);
+  }
+  return this;
+}
+
+///////////////////////////////////////////////////////////////////////
+//
+// Register temporaries
+//
+// call_free(nd, class_tab) holds when code() for the expression emits no
+// jal or jalr, so a value may wait in a spare register while it runs;
+// int_call_free is the same for code_int().
+//
+///////////////////////////////////////////////////////////////////////
+
+Boolean assign_class::call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  Variable *cur = nd->variables.lookup(name);
+  return !cur->raw && (cur->reg != SELF || cgen_Memmgr != GC_GENGC) && expr->call_free(nd, class_tab);
+}
+
+Boolean cond_class::call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  return pred->call_free(nd, class_tab) && then_exp->call_free(nd, class_tab) && else_exp->call_free(nd, class_tab);
+}
+
+Boolean loop_class::call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  return pred->call_free(nd, class_tab) && body->call_free(nd, class_tab);
+}
+
+Boolean block_class::call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  for (int i = body->first(); body->more(i); i = body->next(i))
+    if (!body->nth(i)->call_free(nd, class_tab))
+      return false;
+  return true;
+}
+
+// The identifier is bound while the body is checked, so reads of it
+// know whether they box.
+Boolean let_class::call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  Boolean raw = class_tab->unboxed_lets.count(this);
+  Boolean init_free = raw ? init->int_call_free(nd, class_tab) : init->call_free(nd, class_tab);
+  if (!init_free)
+    return false;
+
+  nd->variables.enterscope();
+  nd->variables.addid(identifier, new Variable(0, FP, raw));
+  Boolean body_free = body->call_free(nd, class_tab);
+  nd->variables.exitscope();
+
+  return body_free;
+}
+
+Boolean object_class::call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  return name == self || !nd->variables.lookup(name)->raw;
+}
+
+Boolean object_class::int_call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  return true;
+}
+
+namespace arith_helpers
+{
+  Boolean raw_stack_safe(Expression rest);
+
+  Boolean operands_call_free(Expression e1, Expression e2, CgenNodeP nd, CgenClassTableP class_tab)
+  {
+    Boolean first = raw_stack_safe(e2) ? e1->int_call_free(nd, class_tab) : e1->call_free(nd, class_tab);
+    return first && e2->int_call_free(nd, class_tab);
+  }
+}
+
+Boolean plus_class::int_call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  return arith_helpers::operands_call_free(e1, e2, nd, class_tab);
+}
+
+Boolean sub_class::int_call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  return arith_helpers::operands_call_free(e1, e2, nd, class_tab);
+}
+
+Boolean mul_class::int_call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  return arith_helpers::operands_call_free(e1, e2, nd, class_tab);
+}
+
+Boolean divide_class::int_call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  return arith_helpers::operands_call_free(e1, e2, nd, class_tab);
+}
+
+Boolean neg_class::int_call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  return e1->int_call_free(nd, class_tab);
+}
+
+Boolean lt_class::call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  if (cgen_optimize)
+    return arith_helpers::operands_call_free(e1, e2, nd, class_tab);
+  return e1->call_free(nd, class_tab) && e2->call_free(nd, class_tab);
+}
+
+Boolean leq_class::call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  if (cgen_optimize)
+    return arith_helpers::operands_call_free(e1, e2, nd, class_tab);
+  return e1->call_free(nd, class_tab) && e2->call_free(nd, class_tab);
+}
+
+Boolean comp_class::call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  return e1->call_free(nd, class_tab);
+}
+
+Boolean isvoid_class::call_free(CgenNodeP nd, CgenClassTableP class_tab)
+{
+  return e1->call_free(nd, class_tab);
 }
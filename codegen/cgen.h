@@ -2,9 +2,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
 #include "cool-tree.h"
 #include "emit.h"
+#include "mips.h"
 #include "symtab.h"
+#include "scopetab.h"
+#include "basic_classes.h"
 #include <optional>
 
 enum Basicness
@@ -26,8 +31,9 @@ struct Variable
   Feature nd;
   int offset;
   Register reg;
-  Variable(const Feature &attr, const int offset, Register reg) : nd(attr), offset(offset), reg(reg) {}
-  Variable(const int offset, Register reg) : nd(NULL), offset(offset), reg(reg) {}
+  bool raw; // holds an unboxed Int value rather than an object
+  Variable(const Feature &attr, const int offset, Register reg) : nd(attr), offset(offset), reg(reg), raw(false) {}
+  Variable(const int offset, Register reg, bool raw = false) : nd(NULL), offset(offset), reg(reg), raw(raw) {}
 };
 
 struct Method
@@ -41,15 +47,40 @@ struct Method
       : class_name(class_name), nd(nd), offset(offset) {}
 };
 
-class CgenClassTable : public SymbolTable<Symbol, CgenNode>
+//
+// Picks the calls cgen expands in place under -O.  A call is inlined
+// when its target is known, is not a basic method, and has a body that
+// makes no dispatch of its own and has at most budget nodes.
+// COOL_INLINE_BUDGET sets the budget (0 turns inlining off) and
+// COOL_INLINE_REPORT writes every decision to stderr.
+//
+class Inliner
+{
+private:
+  int budget;
+  bool report;
+  std::unordered_map<Feature, int> sizes; // -1 for bodies that dispatch
+
+  int body_size(Feature method);
+
+public:
+  Inliner();
+  Boolean should_inline(CgenNodeP caller, int line, CgenNodeP owner, const Method &method);
+};
+
+class CgenClassTable : public ScopedTable<Symbol, CgenNode>
 {
 private:
   std::list<CgenNodeP> nds;
+  CgenNodeP basic_nodes[N_BASIC_CLASSES]; // indexed like basic_class_info
   std::ostream &str;
+  MipsCode text; // class init and method code, printed last
   int next_tag;
+  std::vector<Register> free_temps;
 
   void code_global_data();
   void code_global_text();
+  void code_jump_tables();
   void code_bools();
   void code_select_gc();
   void code_constants();
@@ -68,11 +99,62 @@ private:
   void install_tags(CgenNodeP);
   void set_relations(CgenNodeP nd);
 
+  void build_basic_layouts();
+  void build_layouts(CgenNodeP);
+  void analyze_hierarchy(CgenNodeP);
+  void fold_constants();
+  void eliminate_dead_code();
+  void prune_dead_classes(CgenNodeP);
+
 public:
   CgenClassTable(Classes, std::ostream &str);
   void code();
   CgenNodeP root();
-  SymbolTable<Symbol, int> class_to_tag_table;
+  ScopedTable<Symbol, int> class_to_tag_table;
+
+  // Filled by Reachability; only consulted once dead code was eliminated.
+  std::unordered_set<Feature> live_methods;
+  bool pruned;
+  bool is_dead(const Method &);
+
+  // Dispatch and case expressions whose receiver can never be void.
+  std::unordered_set<Expression> non_void_receivers;
+
+  // Spare registers for expression temporaries.  acquire_temp returns
+  // NULL when they are all in use.
+  Register acquire_temp();
+  void release_temp(Register);
+
+  // Int lets kept unboxed, and expressions whose value is discarded.
+  std::unordered_set<Expression> unboxed_lets;
+  std::unordered_set<Expression> unused_values;
+
+  // Lets whose new object never escapes them, with its size in words.
+  // Under -O without a collector the object is built in the let's slots.
+  std::unordered_map<Expression, int> stack_objects;
+
+  // Case dispatch tables, indexed by class tag.  They are emitted with
+  // the data once the method code is built.
+  struct JumpTable
+  {
+    int label;
+    std::vector<int> targets;
+  };
+  std::vector<JumpTable> jump_tables;
+
+  Inliner inliner;
+
+  // Self-calls in tail position under -O, and the label just after the
+  // prologue of the method being coded, which they branch back to.
+  std::unordered_set<Expression> tail_calls;
+  int tail_call_label;
+
+  // Under -O let and case variables take the slots reserved in the frame
+  // of the method being coded: next_slot is the height of the next free
+  // one, and frame_base the first height below them all.
+  Boolean fixed_slots;
+  int next_slot;
+  int frame_base;
 };
 
 class CgenNode : public class__class
@@ -83,9 +165,26 @@ private:
   Basicness basic_status;
 
 public:
-  SymbolTable<Symbol, Variable> variables;
+  ScopedTable<Symbol, Variable> variables;
   std::vector<Method> methods;
 
+  // The attribute bindings alone, for method bodies inlined elsewhere.
+  ScopedTable<Symbol, Variable> attributes;
+  std::unordered_map<Symbol, int> method_slots;
+
+  // Class hierarchy analysis: for each dispatch slot, the one class whose
+  // implementation every object of this class or a subclass runs, or NULL
+  // when some subclass overrides it.
+  std::vector<Symbol> slot_targets;
+
+  // Cleared for classes that dead code elimination drops from the output.
+  bool live;
+
+  // Largest tag in the subtree rooted at this class.  Tags are numbered
+  // depth first, so the class and its subclasses hold exactly the tags
+  // from its own up to this one.
+  int max_tag;
+
   CgenNode(Class_ c,
            Basicness bstatus,
            CgenClassTableP class_table);
@@ -96,16 +195,164 @@ public:
   CgenNodeP get_parentnd();
   int basic() { return (basic_status == Basic); }
 
-  void code(ostream &s, const int &);
+  void layout();
+  void layout_basic(const BasicLayout &, CgenNodeP const *basic_nodes);
+  void code(ostream &s, const int &, CgenClassTableP);
   void insert_method(const Feature &, int &);
 
   void code_prot_obj(ostream &s, const int &);
-  void code_disp_tab(ostream &s);
+  void code_disp_tab(ostream &s, CgenClassTableP);
 
-  void code_methods(ostream &s, CgenClassTableP);
-  void code_method(ostream &s, Feature &f, CgenClassTableP);
+  void code_methods(MipsCode &s, CgenClassTableP);
+  void code_method(MipsCode &s, Feature &f, CgenClassTableP);
   
-  void code_init(ostream &s, CgenClassTableP);
+  void code_init(MipsCode &s, CgenClassTableP);
+  Boolean has_initializers();
+};
+
+//
+// Whole-program reachability from Main.main and Main_init.  Classes become
+// live when they are instantiated, named by a static dispatch, or are an
+// ancestor of a live class.  A dynamic dispatch reaches the implementation
+// of its slot in every instantiated class below the receiver's static type
+// (plus the unique implementation, when class hierarchy analysis found one).
+//
+class Reachability
+{
+private:
+  CgenClassTableP class_tab;
+  std::unordered_set<CgenNodeP> instantiated;
+  std::unordered_map<CgenNodeP, std::unordered_set<int>> sites;
+  std::vector<std::pair<CgenNodeP, Expression>> worklist;
+
+  void reach_instances(CgenNodeP, int slot);
+
+public:
+  Reachability(CgenClassTableP class_tab) : class_tab(class_tab) {}
+
+  void make_live(CgenNodeP);
+  void instantiate(CgenNodeP);
+  void reach_method(CgenNodeP, int slot);
+  void dispatch(CgenNodeP static_class, int slot);
+  void run();
+
+  CgenClassTableP get_class_table() { return class_tab; }
+};
+
+//
+// Flow-sensitive nullness over one method body or attribute initializer.
+// Expressions are visited in the order cgen evaluates them; facts holds
+// the variables known to be non-void at the current point.  A name that
+// is not bound by a formal, let or case branch is an attribute, and any
+// call may assign it, so calls drop the facts about attributes.
+//
+class Nullness
+{
+private:
+  CgenClassTableP class_tab;
+  CgenNodeP nd;
+  std::unordered_map<Symbol, int> locals;
+  Boolean marking;
+
+public:
+  typedef std::unordered_set<Symbol> Facts;
+  Facts facts;
+
+  Nullness(CgenClassTableP class_tab, CgenNodeP nd) : class_tab(class_tab), nd(nd), marking(true) {}
+
+  Boolean basic_value(Symbol type);
+  Boolean returns_receiver(const Method &);
+  void set(Symbol name, Boolean non_void);
+  void checked(Expression receiver);
+  void call();
+  void meet(const Facts &other);
+  void mark(Expression site);
+  Boolean suspend_marks();
+  void resume_marks(Boolean);
+
+  // bind returns whether the shadowed binding was non-void, for unbind.
+  Boolean bind(Symbol name, Boolean non_void);
+  void unbind(Symbol name, Boolean outer);
+
+  CgenNodeP get_class() { return nd; }
+  CgenClassTableP get_class_table() { return class_tab; }
+};
+
+//
+// Chooses the Int lets of a method that can hold a raw value in their
+// stack slot: those whose every use is an arithmetic or comparison
+// operand, or the right-hand side of an assignment to another such let.
+// Raw slots are only used without a collector, so the GC never scans
+// them.
+//
+class Unboxing
+{
+private:
+  CgenClassTableP class_tab;
+  std::unordered_map<Symbol, std::vector<Expression>> scopes;
+  std::vector<Expression> candidates;
+  std::unordered_set<Expression> boxed;
+
+public:
+  Unboxing(CgenClassTableP class_tab) : class_tab(class_tab) {}
+
+  // let is NULL for bindings that are never unboxed.
+  void bind(Symbol name, Expression let);
+  void unbind(Symbol name);
+  Boolean is_candidate(Symbol name);
+  void use(Symbol name, Boolean int_context);
+  void discard(Expression e);
+  void finish();
+};
+
+//
+// Escape analysis for the object a let creates with new.  The object
+// escapes when a pointer to it may outlive the let: when the variable's
+// value is stored, passed, bound to another name, scrutinized by a case
+// or becomes the value of the let.  A dispatch on the variable runs a
+// method of exactly the class new named, so it is followed into that
+// method, where self stands for the object.  summary says whether self
+// escapes a method and whether the method may return it; recursive
+// methods are iterated to a fixed point.
+//
+class Escape
+{
+public:
+  struct Summary
+  {
+    Boolean escapes;
+    Boolean returns_self;
+  };
+
+private:
+  CgenClassTableP class_tab;
+  CgenNodeP cls;
+  std::unordered_map<Feature, Summary> summaries;
+  std::unordered_set<Feature> visited;
+  Boolean changed;
+
+  Summary analyze(const Method &);
+  Boolean init_escapes();
+
+public:
+  Escape(CgenClassTableP class_tab) : class_tab(class_tab), cls(NULL), changed(false) {}
+
+  Boolean new_escapes(CgenNodeP cls, Symbol var, Expression body);
+  Summary summary(const Method &);
+
+  CgenNodeP get_class() { return cls; }
+  CgenClassTableP get_class_table() { return class_tab; }
+};
+
+//
+// What the body of a leaf method needs from its frame: whether it uses
+// $s0 (self or an attribute) and whether it addresses formals or let
+// slots off $fp.  Only computed for bodies that make no calls.
+//
+struct FrameUse
+{
+  Boolean self;
+  Boolean fp;
 };
 
 class BoolConst
@@ -41,7 +41,7 @@ void emit_string_constant(std::ostream& str, const char* s)
       break;
     case '\\':
       byte_mode(str);
-      str << "\t.byte\t" << (int) ((unsigned char) '\\') << std::endl;
+      str << "\t.byte\t" << (int) ((unsigned char) '\\') << "\n";
       break;
     case '"' :
       ascii_mode(str);
@@ -56,14 +56,14 @@ void emit_string_constant(std::ostream& str, const char* s)
       else 
 	{
 	  byte_mode(str);
-	  str << "\t.byte\t" << (int) ((unsigned char) *s) << std::endl;
+	  str << "\t.byte\t" << (int) ((unsigned char) *s) << "\n";
 	}
       break;
     }
     s++;
   }
   byte_mode(str);
-  str << "\t.byte\t0\t" << std::endl;
+  str << "\t.byte\t0\t" << "\n";
 }
 
 
@@ -2,6 +2,8 @@
 #define COOL_TREE_HANDCODE_H
 
 #include <iostream>
+#include <algorithm>
+#include <vector>
 #include "tree.h"
 #include "stringtab.h"
 #define yylineno curr_lineno
@@ -36,6 +38,12 @@ class CgenNode;
 typedef CgenNode *CgenNodeP;
 class CgenClassTable;
 typedef CgenClassTable *CgenClassTableP;
+class Reachability;
+class Nullness;
+class MipsCode;
+class Unboxing;
+class Escape;
+struct FrameUse;
 
 typedef list_node<Class_> Classes_class;
 typedef Classes_class *Classes;
@@ -47,6 +55,7 @@ typedef list_node<Expression> Expressions_class;
 typedef Expressions_class *Expressions;
 typedef list_node<Case> Cases_class;
 typedef Cases_class *Cases;
+typedef std::vector<Expression> ExprList;
 
 #define Program_EXTRAS					\
   virtual void cgen(ostream&) = 0;			\
@@ -77,6 +86,7 @@ typedef Cases_class *Cases;
   virtual Symbol get_type_decl() = 0;                                                        \
   virtual Formals get_formals() = 0;                                                        \
   virtual Expression get_expr() = 0;                                                        \
+  virtual void set_expr(Expression) = 0;                                                    \
   virtual void dump_with_types(ostream &, int) = 0;
 
 #define Feature_SHARED_EXTRAS					\
@@ -98,6 +108,7 @@ typedef Cases_class *Cases;
   Symbol get_ret() { return NULL; }                                             \
   Symbol get_type_decl() { return type_decl; }                                   \
   Expression get_expr() { return init; }                                        \
+  void set_expr(Expression e) { init = e; }                                     \
   Boolean is_attr() { return true; };
 
 #define method_EXTRAS                                                           \
@@ -105,41 +116,247 @@ typedef Cases_class *Cases;
   Symbol get_ret() { return return_type; }                                      \
   Symbol get_type_decl() { return NULL; }                                        \
   Expression get_expr() { return expr; }                                        \
+  void set_expr(Expression e) { expr = e; }                                     \
   Boolean is_attr() { return false; };
 
 #define Case_EXTRAS							\
-  virtual void code(ostream&, CgenNodeP, CgenClassTableP, int) = 0;					\
+  virtual void code(MipsCode&, CgenNodeP, CgenClassTableP, int) = 0;					\
   virtual Symbol get_type_decl() = 0; \
   virtual Symbol get_name() = 0; \
+  virtual Expression get_expr() = 0; \
+  virtual void fold() = 0; \
   virtual void dump_with_types(ostream& ,int) = 0;
 
 #define branch_EXTRAS						\
   Symbol get_type_decl() { return type_decl; } \
   Symbol get_name() { return name; } \
-  void code(ostream&, CgenNodeP, CgenClassTableP, int);						\
+  Expression get_expr() { return expr; } \
+  void fold(); \
+  void code(MipsCode&, CgenNodeP, CgenClassTableP, int);						\
   void dump_with_types(ostream& ,int);
 
 #define Expression_EXTRAS					   \
-  virtual void code(ostream&, CgenNodeP, CgenClassTableP, int) = 0;				   \
+  virtual void code(MipsCode&, CgenNodeP, CgenClassTableP, int) = 0;				   \
   Symbol type;							   \
   Symbol get_type() { return type; }				   \
   Expression set_type(Symbol s) { type = s; return this; }	   \
   virtual void dump_with_types(ostream&,int) = 0;		   \
   void dump_type(ostream&, int);				   \
   inline virtual Boolean is_no_expr() { return false; } \
+  inline virtual Symbol variable_name() { return NULL; } \
+  inline virtual Boolean allocation_free() { return false; } \
+  inline virtual Boolean int_value(int &) { return false; } \
+  inline virtual Boolean bool_value(Boolean &) { return false; } \
+  inline virtual Boolean is_literal() { return false; } \
+  inline virtual Boolean is_new() { return false; } \
+  inline virtual Boolean is_dispatch() { return false; } \
+  inline virtual Boolean mark_tail_calls(Feature, CgenNodeP, CgenClassTableP) { return false; } \
+  inline virtual Expression fold() { return this; } \
+  inline virtual Boolean call_free(CgenNodeP, CgenClassTableP) { return false; } \
+  inline virtual Boolean int_call_free(CgenNodeP nd, CgenClassTableP class_tab) { return call_free(nd, class_tab); } \
+  virtual void children(ExprList &) = 0; \
+  virtual Boolean non_void(Nullness &); \
+  virtual void code_int(MipsCode&, CgenNodeP, CgenClassTableP, int); \
+  virtual void code_branch(MipsCode&, CgenNodeP, CgenClassTableP, int, Boolean when, int label); \
+  virtual void plan_unboxing(Unboxing &, Boolean int_context); \
+  virtual Boolean escapes(Escape &, Symbol var, Boolean value_used); \
+  virtual void plan_stack_objects(Escape &); \
+  virtual void reach(Reachability &r, CgenNodeP nd) \
+  { \
+    ExprList ls; \
+    children(ls); \
+    for (Expression e : ls) \
+      e->reach(r, nd); \
+  } \
+  virtual int slot_depth(CgenClassTableP class_tab) \
+  { \
+    ExprList ls; \
+    children(ls); \
+    int depth = 0; \
+    for (Expression e : ls) \
+      depth = std::max(depth, e->slot_depth(class_tab)); \
+    return depth; \
+  } \
+  virtual void frame_use(CgenNodeP nd, FrameUse &use) \
+  { \
+    ExprList ls; \
+    children(ls); \
+    for (Expression e : ls) \
+      e->frame_use(nd, use); \
+  } \
   Expression_class() { type = (Symbol) NULL; }
 
 #define Expression_SHARED_EXTRAS				\
-  void code(ostream&, CgenNodeP, CgenClassTableP, int); \
+  void code(MipsCode&, CgenNodeP, CgenClassTableP, int); \
+  void children(ExprList &); \
   void dump_with_types(ostream&,int);
 
+#define assign_EXTRAS \
+  Boolean escapes(Escape &, Symbol, Boolean); \
+  void frame_use(CgenNodeP, FrameUse &); \
+  Boolean call_free(CgenNodeP, CgenClassTableP); \
+  Expression fold(); \
+  Boolean non_void(Nullness &); \
+  void code_int(MipsCode&, CgenNodeP, CgenClassTableP, int); \
+  void plan_unboxing(Unboxing &, Boolean);
+
+#define static_dispatch_EXTRAS \
+  Boolean escapes(Escape &, Symbol, Boolean); \
+  Boolean mark_tail_calls(Feature, CgenNodeP, CgenClassTableP); \
+  Boolean is_dispatch() { return true; } \
+  Expression fold(); \
+  void reach(Reachability &, CgenNodeP); \
+  Boolean non_void(Nullness &);
+
+#define dispatch_EXTRAS \
+  Boolean escapes(Escape &, Symbol, Boolean); \
+  Boolean mark_tail_calls(Feature, CgenNodeP, CgenClassTableP); \
+  Boolean is_dispatch() { return true; } \
+  Expression fold(); \
+  void reach(Reachability &, CgenNodeP); \
+  Boolean non_void(Nullness &);
+
+#define cond_EXTRAS \
+  Boolean escapes(Escape &, Symbol, Boolean); \
+  Boolean mark_tail_calls(Feature, CgenNodeP, CgenClassTableP); \
+  Boolean call_free(CgenNodeP, CgenClassTableP); \
+  Expression fold(); \
+  Boolean non_void(Nullness &);
+
+#define loop_EXTRAS \
+  Boolean escapes(Escape &, Symbol, Boolean); \
+  Boolean call_free(CgenNodeP, CgenClassTableP); \
+  Expression fold(); \
+  Boolean non_void(Nullness &); \
+  void plan_unboxing(Unboxing &, Boolean);
+
+#define typcase_EXTRAS \
+  Boolean escapes(Escape &, Symbol, Boolean); \
+  int slot_depth(CgenClassTableP); \
+  void frame_use(CgenNodeP, FrameUse &); \
+  Boolean mark_tail_calls(Feature, CgenNodeP, CgenClassTableP); \
+  Expression fold(); \
+  Boolean non_void(Nullness &);
+
+#define block_EXTRAS \
+  Boolean escapes(Escape &, Symbol, Boolean); \
+  Boolean mark_tail_calls(Feature, CgenNodeP, CgenClassTableP); \
+  Boolean call_free(CgenNodeP, CgenClassTableP); \
+  Expression fold(); \
+  Boolean non_void(Nullness &); \
+  void plan_unboxing(Unboxing &, Boolean);
+
+#define let_EXTRAS \
+  Boolean escapes(Escape &, Symbol, Boolean); \
+  void plan_stack_objects(Escape &); \
+  int slot_depth(CgenClassTableP); \
+  void frame_use(CgenNodeP, FrameUse &); \
+  Boolean mark_tail_calls(Feature, CgenNodeP, CgenClassTableP); \
+  Boolean call_free(CgenNodeP, CgenClassTableP); \
+  Expression fold(); \
+  Boolean non_void(Nullness &); \
+  void plan_unboxing(Unboxing &, Boolean);
+
+#define new__EXTRAS \
+  inline Boolean is_new() { return true; } \
+  void reach(Reachability &, CgenNodeP); \
+  Boolean non_void(Nullness &);
+
+#define object_EXTRAS \
+  Boolean escapes(Escape &, Symbol, Boolean); \
+  void frame_use(CgenNodeP, FrameUse &); \
+  Boolean int_call_free(CgenNodeP, CgenClassTableP); \
+  Boolean call_free(CgenNodeP, CgenClassTableP); \
+  Symbol variable_name() { return name; } \
+  Boolean non_void(Nullness &); \
+  void code_int(MipsCode&, CgenNodeP, CgenClassTableP, int); \
+  inline Boolean allocation_free() { return true; } \
+  void plan_unboxing(Unboxing &, Boolean);
+
+#define plus_EXTRAS \
+  Boolean int_call_free(CgenNodeP, CgenClassTableP); \
+  Expression fold(); \
+  void code_int(MipsCode&, CgenNodeP, CgenClassTableP, int); \
+  inline Boolean allocation_free() { return e1->allocation_free() && e2->allocation_free(); } \
+  void plan_unboxing(Unboxing &, Boolean);
+
+#define sub_EXTRAS \
+  Boolean int_call_free(CgenNodeP, CgenClassTableP); \
+  Expression fold(); \
+  void code_int(MipsCode&, CgenNodeP, CgenClassTableP, int); \
+  inline Boolean allocation_free() { return e1->allocation_free() && e2->allocation_free(); } \
+  void plan_unboxing(Unboxing &, Boolean);
+
+#define mul_EXTRAS \
+  Boolean int_call_free(CgenNodeP, CgenClassTableP); \
+  Expression fold(); \
+  void code_int(MipsCode&, CgenNodeP, CgenClassTableP, int); \
+  inline Boolean allocation_free() { return e1->allocation_free() && e2->allocation_free(); } \
+  void plan_unboxing(Unboxing &, Boolean);
+
+#define divide_EXTRAS \
+  Boolean int_call_free(CgenNodeP, CgenClassTableP); \
+  Expression fold(); \
+  void code_int(MipsCode&, CgenNodeP, CgenClassTableP, int); \
+  inline Boolean allocation_free() { return e1->allocation_free() && e2->allocation_free(); } \
+  void plan_unboxing(Unboxing &, Boolean);
+
+#define neg_EXTRAS \
+  Boolean int_call_free(CgenNodeP, CgenClassTableP); \
+  Expression fold(); \
+  void code_int(MipsCode&, CgenNodeP, CgenClassTableP, int); \
+  inline Boolean allocation_free() { return e1->allocation_free(); } \
+  void plan_unboxing(Unboxing &, Boolean);
+
+#define lt_EXTRAS \
+  void code_branch(MipsCode&, CgenNodeP, CgenClassTableP, int, Boolean, int); \
+  Boolean call_free(CgenNodeP, CgenClassTableP); \
+  Expression fold(); \
+  void plan_unboxing(Unboxing &, Boolean);
+
+#define leq_EXTRAS \
+  void code_branch(MipsCode&, CgenNodeP, CgenClassTableP, int, Boolean, int); \
+  Boolean call_free(CgenNodeP, CgenClassTableP); \
+  Expression fold(); \
+  void plan_unboxing(Unboxing &, Boolean);
+
+#define eq_EXTRAS \
+  Boolean escapes(Escape &, Symbol, Boolean); \
+  void code_branch(MipsCode&, CgenNodeP, CgenClassTableP, int, Boolean, int); \
+  Expression fold();
+
+#define comp_EXTRAS \
+  void code_branch(MipsCode&, CgenNodeP, CgenClassTableP, int, Boolean, int); \
+  Boolean call_free(CgenNodeP, CgenClassTableP); \
+  Expression fold();
+
+#define isvoid_EXTRAS \
+  Boolean escapes(Escape &, Symbol, Boolean); \
+  void code_branch(MipsCode&, CgenNodeP, CgenClassTableP, int, Boolean, int); \
+  Boolean call_free(CgenNodeP, CgenClassTableP); \
+  Expression fold();
+
 #define int_const_EXTRAS \
-  Symbol get_val() { return token; }
+  inline Boolean call_free(CgenNodeP, CgenClassTableP) { return true; } \
+  Symbol get_val() { return token; } \
+  void code_int(MipsCode&, CgenNodeP, CgenClassTableP, int); \
+  inline Boolean allocation_free() { return true; } \
+  Boolean int_value(int &); \
+  inline Boolean is_literal() { return true; }
+
+#define bool_const_EXTRAS \
+  void code_branch(MipsCode&, CgenNodeP, CgenClassTableP, int, Boolean, int); \
+  inline Boolean call_free(CgenNodeP, CgenClassTableP) { return true; } \
+  inline Boolean bool_value(Boolean &v) { v = val; return true; } \
+  inline Boolean is_literal() { return true; }
 
 #define string_const_EXTRAS \
-  Symbol get_val() { return token; }
+  inline Boolean call_free(CgenNodeP, CgenClassTableP) { return true; } \
+  Symbol get_val() { return token; } \
+  inline Boolean is_literal() { return true; }
 
 #define no_expr_EXTRAS                         \
+  inline Boolean call_free(CgenNodeP, CgenClassTableP) { return true; } \
   inline Boolean is_no_expr() { return true; }
 
 #endif  // COOL_TREE_HANDCODE_H
@@ -86,6 +86,8 @@ Register const RA = "$ra";     // Return address
 // Opcodes
 //
 #define JALR "\tjalr\t"
+#define JR "\tjr\t"
+#define JUMP "\tj\t"
 #define JAL "\tjal\t"
 #define RET "\tjr\t$ra\t"
 
@@ -0,0 +1,285 @@
+#include <string.h>
+#include "mips.h"
+#include "emit.h"
+
+static void append_label(std::string &out, int label)
+{
+  out += "label";
+  out += std::to_string(label);
+}
+
+static void append_rrr(std::string &out, const char *opcode, const Instr &i)
+{
+  out += opcode;
+  out += i.rd;
+  out += " ";
+  out += i.rs;
+  out += " ";
+  out += i.rt;
+  out += "\n";
+}
+
+static void append_rri(std::string &out, const char *opcode, const Instr &i)
+{
+  out += opcode;
+  out += i.rd;
+  out += " ";
+  out += i.rs;
+  out += " ";
+  out += std::to_string(i.imm);
+  out += "\n";
+}
+
+static void append_memory(std::string &out, const char *opcode, const Instr &i)
+{
+  out += opcode;
+  out += i.rd;
+  out += " ";
+  out += std::to_string(i.imm);
+  out += "(";
+  out += i.rs;
+  out += ")\n";
+}
+
+static void append_branch(std::string &out, const char *opcode, const Instr &i)
+{
+  out += opcode;
+  out += i.rs;
+  out += " ";
+  if (i.rt)
+    out += i.rt;
+  else
+    out += std::to_string(i.imm);
+  out += " ";
+  append_label(out, i.label);
+  out += "\n";
+}
+
+//
+// The text is exactly what the emit_* helpers used to write to the
+// output stream.
+//
+void print_instr(std::string &out, const Instr &i)
+{
+  switch (i.op)
+  {
+  case OP_LW:
+    append_memory(out, LW, i);
+    break;
+  case OP_SW:
+    append_memory(out, SW, i);
+    break;
+  case OP_LI:
+    out += LI;
+    out += i.rd;
+    out += " ";
+    out += std::to_string(i.imm);
+    out += "\n";
+    break;
+  case OP_LA:
+    out += LA;
+    out += i.rd;
+    out += " ";
+    out += i.sym;
+    out += "\n";
+    break;
+  case OP_MOVE:
+    out += MOVE;
+    out += i.rd;
+    out += " ";
+    out += i.rs;
+    out += "\n";
+    break;
+  case OP_NEG:
+    out += NEG;
+    out += i.rd;
+    out += " ";
+    out += i.rs;
+    out += "\n";
+    break;
+  case OP_ADD:
+    append_rrr(out, ADD, i);
+    break;
+  case OP_ADDU:
+    append_rrr(out, ADDU, i);
+    break;
+  case OP_ADDIU:
+    append_rri(out, ADDIU, i);
+    break;
+  case OP_DIV:
+    append_rrr(out, DIV, i);
+    break;
+  case OP_MUL:
+    append_rrr(out, MUL, i);
+    break;
+  case OP_SUB:
+    append_rrr(out, SUB, i);
+    break;
+  case OP_SLL:
+    append_rri(out, SLL, i);
+    break;
+  case OP_JALR:
+    out += JALR;
+    out += "\t";
+    out += i.rs;
+    out += "\n";
+    break;
+  case OP_JR:
+    out += JR;
+    out += i.rs;
+    out += "\n";
+    break;
+  case OP_JAL:
+    out += JAL;
+    out += i.sym;
+    out += "\n";
+    break;
+  case OP_JUMP:
+    out += JUMP;
+    out += i.sym;
+    out += "\n";
+    break;
+  case OP_RET:
+    out += RET;
+    out += "\n";
+    break;
+  case OP_BEQZ:
+    out += BEQZ;
+    out += i.rs;
+    out += " ";
+    append_label(out, i.label);
+    out += "\n";
+    break;
+  case OP_BEQ:
+    append_branch(out, BEQ, i);
+    break;
+  case OP_BNE:
+    append_branch(out, BNE, i);
+    break;
+  case OP_BLEQ:
+    append_branch(out, BLEQ, i);
+    break;
+  case OP_BLT:
+  case OP_BLTI:
+    append_branch(out, BLT, i);
+    break;
+  case OP_BGTI:
+    append_branch(out, BGT, i);
+    break;
+  case OP_BRANCH:
+    out += BRANCH;
+    append_label(out, i.label);
+    out += "\n";
+    break;
+  case OP_LABEL:
+    append_label(out, i.label);
+    out += ":\n";
+    break;
+  case OP_ENTRY:
+    out += i.sym;
+    out += LABEL;
+    break;
+  case OP_NOP:
+    break;
+  }
+}
+
+bool same_reg(Register a, Register b)
+{
+  return a && b && (a == b || !strcmp(a, b));
+}
+
+bool is_branch(const Instr &i)
+{
+  switch (i.op)
+  {
+  case OP_BEQZ:
+  case OP_BEQ:
+  case OP_BNE:
+  case OP_BLEQ:
+  case OP_BLT:
+  case OP_BLTI:
+  case OP_BGTI:
+  case OP_BRANCH:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool is_call(const Instr &i)
+{
+  return i.op == OP_JAL || i.op == OP_JALR;
+}
+
+bool is_block_boundary(const Instr &i)
+{
+  return i.op == OP_LABEL || i.op == OP_ENTRY || i.op == OP_RET || i.op == OP_JR || i.op == OP_JUMP || is_branch(i) || is_call(i);
+}
+
+bool reads_reg(const Instr &i, Register r)
+{
+  switch (i.op)
+  {
+  case OP_SW:
+    return same_reg(i.rd, r) || same_reg(i.rs, r);
+  case OP_JAL:
+  case OP_JALR:
+  case OP_JUMP:
+  case OP_RET:
+    return true;
+  case OP_LI:
+  case OP_LA:
+  case OP_LABEL:
+  case OP_ENTRY:
+  case OP_NOP:
+    return false;
+  default:
+    return same_reg(i.rs, r) || same_reg(i.rt, r);
+  }
+}
+
+bool writes_reg(const Instr &i, Register r)
+{
+  switch (i.op)
+  {
+  case OP_JAL:
+  case OP_JALR:
+    return true;
+  case OP_LW:
+  case OP_LI:
+  case OP_LA:
+  case OP_MOVE:
+  case OP_NEG:
+  case OP_ADD:
+  case OP_ADDU:
+  case OP_ADDIU:
+  case OP_DIV:
+  case OP_MUL:
+  case OP_SUB:
+  case OP_SLL:
+    return same_reg(i.rd, r);
+  default:
+    return false;
+  }
+}
+
+void MipsCode::print(std::ostream &s) const
+{
+  const size_t chunk = 1 << 20;
+  std::string out;
+  out.reserve(chunk + 256);
+
+  for (const Instr &i : instrs)
+  {
+    print_instr(out, i);
+    if (out.size() >= chunk)
+    {
+      s.write(out.data(), out.size());
+      out.clear();
+    }
+  }
+
+  s.write(out.data(), out.size());
+  s.flush();
+}
@@ -0,0 +1,97 @@
+#ifndef MIPS_H_
+#define MIPS_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+typedef const char *Register;
+
+//
+// The text segment as a list of MIPS instructions.  Code generation
+// appends to a MipsCode instead of formatting assembly as it goes, so
+// later passes can rewrite the code before it is printed.
+//
+enum Opcode
+{
+  OP_LW,     // lw    rd imm(rs)
+  OP_SW,     // sw    rd imm(rs)
+  OP_LI,     // li    rd imm
+  OP_LA,     // la    rd sym
+  OP_MOVE,   // move  rd rs
+  OP_NEG,    // neg   rd rs
+  OP_ADD,    // add   rd rs rt
+  OP_ADDU,   // addu  rd rs rt
+  OP_ADDIU,  // addiu rd rs imm
+  OP_DIV,    // div   rd rs rt
+  OP_MUL,    // mul   rd rs rt
+  OP_SUB,    // sub   rd rs rt
+  OP_SLL,    // sll   rd rs imm
+  OP_JALR,   // jalr  rs
+  OP_JR,     // jr    rs
+  OP_JAL,    // jal   sym
+  OP_JUMP,   // j     sym
+  OP_RET,    // jr    $ra
+  OP_BEQZ,   // beqz  rs label
+  OP_BEQ,    // beq   rs rt label
+  OP_BNE,    // bne   rs rt label
+  OP_BLEQ,   // ble   rs rt label
+  OP_BLT,    // blt   rs rt label
+  OP_BLTI,   // blt   rs imm label
+  OP_BGTI,   // bgt   rs imm label
+  OP_BRANCH, // b     label
+  OP_LABEL,  // label:
+  OP_ENTRY,  // sym:
+  OP_NOP,    // deleted by a pass; prints nothing
+};
+
+struct Instr
+{
+  Opcode op;
+  Register rd;
+  Register rs;
+  Register rt;
+  int imm;         // immediate; byte offset for lw and sw
+  int label;       // numbered label defined or branched to
+  std::string sym; // symbolic address or entry point name
+
+  Instr(Opcode op, Register rd = NULL, Register rs = NULL, Register rt = NULL, int imm = 0)
+      : op(op), rd(rd), rs(rs), rt(rt), imm(imm), label(-1) {}
+};
+
+class MipsCode
+{
+private:
+  std::vector<Instr> instrs;
+
+public:
+  Instr &append(const Instr &instr)
+  {
+    instrs.push_back(instr);
+    return instrs.back();
+  }
+
+  std::vector<Instr> &instructions() { return instrs; }
+
+  // Writes the assembly for every instruction in one pass through a
+  // single large buffer.
+  void print(std::ostream &s) const;
+};
+
+void print_instr(std::string &out, const Instr &instr);
+
+//
+// Operand queries for passes over the list.  Registers are compared by
+// name.  Calls are treated as reading and writing every register, and
+// jumps out of the routine and the return as reading every register.
+//
+bool same_reg(Register a, Register b);
+bool reads_reg(const Instr &instr, Register r);
+bool writes_reg(const Instr &instr, Register r);
+bool is_branch(const Instr &instr);
+bool is_call(const Instr &instr);
+
+// Labels, entry points, branches, calls, jumps and returns.
+bool is_block_boundary(const Instr &instr);
+
+#endif
@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "peephole.h"
+#include "emit.h"
+
+static size_t next_instr(const std::vector<Instr> &code, size_t i)
+{
+  for (i++; i < code.size() && code[i].op == OP_NOP; i++)
+    ;
+  return i;
+}
+
+static void kill(Instr &instr)
+{
+  instr.op = OP_NOP;
+}
+
+// Turns instr into "move dest src", or deletes it when that is a no-op.
+static void make_move(Instr &instr, Register dest, Register src)
+{
+  if (same_reg(dest, src))
+    kill(instr);
+  else
+    instr = Instr(OP_MOVE, dest, src);
+}
+
+static bool is_sp_adjust(const Instr &instr, int amount)
+{
+  return instr.op == OP_ADDIU && same_reg(instr.rd, SP) && same_reg(instr.rs, SP) && instr.imm == amount;
+}
+
+// Instructions whose only effect is their destination register.  add
+// and sub trap on overflow and div on zero, so they stay.
+static bool is_pure_write(const Instr &instr)
+{
+  switch (instr.op)
+  {
+  case OP_LI:
+  case OP_LA:
+  case OP_MOVE:
+  case OP_NEG:
+  case OP_ADDU:
+  case OP_ADDIU:
+  case OP_MUL:
+  case OP_SLL:
+    return true;
+  default:
+    return false;
+  }
+}
+
+//
+// sw R 0($sp); addiu $sp $sp -4; S; lw X 4($sp); addiu $sp $sp 4
+//
+// When S leaves $sp alone, the slot only carries R's value to X.  If S
+// never touches X, X takes the value at the push; otherwise, if S never
+// overwrites R, X takes it at the pop.
+//
+static bool push_pop(std::vector<Instr> &code, size_t i)
+{
+  Instr &push = code[i];
+  if (push.op != OP_SW || push.imm != 0 || !same_reg(push.rs, SP) || same_reg(push.rd, SP))
+    return false;
+
+  size_t adjust = next_instr(code, i);
+  if (adjust == code.size() || !is_sp_adjust(code[adjust], -WORD_SIZE))
+    return false;
+
+  std::vector<size_t> between;
+  for (size_t k = next_instr(code, adjust); k < code.size(); k = next_instr(code, k))
+  {
+    Instr &load = code[k];
+    if (load.op == OP_LW && load.imm == WORD_SIZE && same_reg(load.rs, SP))
+    {
+      size_t pop = next_instr(code, k);
+      if (pop == code.size() || !is_sp_adjust(code[pop], WORD_SIZE))
+        return false;
+
+      Register value = push.rd;
+      Register dest = load.rd;
+      bool dest_untouched = true;
+      bool value_kept = true;
+      for (size_t b : between)
+      {
+        dest_untouched = dest_untouched && !reads_reg(code[b], dest) && !writes_reg(code[b], dest);
+        value_kept = value_kept && !writes_reg(code[b], value);
+      }
+
+      if (dest_untouched)
+      {
+        make_move(push, dest, value);
+        kill(load);
+      }
+      else if (value_kept)
+      {
+        kill(push);
+        make_move(load, dest, value);
+      }
+      else
+      {
+        return false;
+      }
+
+      kill(code[adjust]);
+      kill(code[pop]);
+      return true;
+    }
+
+    if (is_block_boundary(load) || reads_reg(load, SP) || writes_reg(load, SP))
+      return false;
+    between.push_back(k);
+  }
+  return false;
+}
+
+//
+// sw R off(B); ...; lw X off(B)  =>  sw R off(B); ...; move X R
+//
+// Any other store might write the same word, so it ends the search.
+//
+static bool store_load(std::vector<Instr> &code, size_t i)
+{
+  Instr &store = code[i];
+  if (store.op != OP_SW)
+    return false;
+
+  for (size_t k = next_instr(code, i); k < code.size(); k = next_instr(code, k))
+  {
+    Instr &instr = code[k];
+    if (instr.op == OP_LW && same_reg(instr.rs, store.rs) && instr.imm == store.imm)
+    {
+      make_move(instr, instr.rd, store.rd);
+      return true;
+    }
+
+    if (is_block_boundary(instr) || instr.op == OP_SW ||
+        writes_reg(instr, store.rd) || writes_reg(instr, store.rs))
+      return false;
+  }
+  return false;
+}
+
+// move R R
+static bool self_move(std::vector<Instr> &code, size_t i)
+{
+  if (code[i].op != OP_MOVE || !same_reg(code[i].rd, code[i].rs))
+    return false;
+
+  kill(code[i]);
+  return true;
+}
+
+//
+// A register written again before it is read.  The register is assumed
+// live at the end of the block.
+//
+static bool dead_write(std::vector<Instr> &code, size_t i)
+{
+  Instr &write = code[i];
+  if (!is_pure_write(write) || same_reg(write.rd, SP))
+    return false;
+
+  for (size_t k = next_instr(code, i); k < code.size(); k = next_instr(code, k))
+  {
+    if (reads_reg(code[k], write.rd))
+      return false;
+    if (writes_reg(code[k], write.rd))
+    {
+      kill(write);
+      return true;
+    }
+    if (is_block_boundary(code[k]))
+      return false;
+  }
+  return false;
+}
+
+// A branch to one of the labels right after it.
+static bool branch_to_next(std::vector<Instr> &code, size_t i)
+{
+  if (!is_branch(code[i]))
+    return false;
+
+  for (size_t k = next_instr(code, i); k < code.size() && code[k].op == OP_LABEL; k = next_instr(code, k))
+  {
+    if (code[k].label == code[i].label)
+    {
+      kill(code[i]);
+      return true;
+    }
+  }
+  return false;
+}
+
+// addiu R R a; addiu R R b  =>  addiu R R a+b, and addiu R R 0 goes.
+static bool merge_addiu(std::vector<Instr> &code, size_t i)
+{
+  Instr &first = code[i];
+  if (first.op != OP_ADDIU || !same_reg(first.rd, first.rs))
+    return false;
+
+  if (first.imm == 0)
+  {
+    kill(first);
+    return true;
+  }
+
+  size_t k = next_instr(code, i);
+  if (k == code.size())
+    return false;
+
+  Instr &second = code[k];
+  if (second.op != OP_ADDIU || !same_reg(second.rd, first.rd) || !same_reg(second.rs, first.rd))
+    return false;
+
+  first.imm += second.imm;
+  kill(second);
+  return true;
+}
+
+static const Peephole::Rule rules[] = {
+    {"push-pop", push_pop},
+    {"store-load", store_load},
+    {"self-move", self_move},
+    {"dead-write", dead_write},
+    {"branch-to-next", branch_to_next},
+    {"merge-addiu", merge_addiu},
+};
+
+#define N_RULES (sizeof(rules) / sizeof(rules[0]))
+
+Peephole::Peephole() : counts(N_RULES, 0) {}
+
+void Peephole::run(MipsCode &code)
+{
+  std::vector<Instr> &instrs = code.instructions();
+
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (size_t i = 0; i < instrs.size(); i++)
+    {
+      for (size_t r = 0; r < N_RULES && instrs[i].op != OP_NOP; r++)
+      {
+        if (rules[r].apply(instrs, i))
+        {
+          counts[r]++;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  instrs.erase(std::remove_if(instrs.begin(), instrs.end(), [](const Instr &instr)
+                              { return instr.op == OP_NOP; }),
+               instrs.end());
+}
+
+void Peephole::report(std::ostream &s) const
+{
+  char line[64];
+
+  s << "--- peephole ---\n";
+  for (size_t r = 0; r < N_RULES; r++)
+  {
+    snprintf(line, sizeof(line), "%-20s %10lu\n", rules[r].name, counts[r]);
+    s << line;
+  }
+}
+
+bool peephole_enabled(bool optimize)
+{
+  return optimize || getenv("COOL_PEEPHOLE") != nullptr;
+}
+
+bool peephole_report_enabled()
+{
+  return getenv("COOL_PEEPHOLE") != nullptr;
+}
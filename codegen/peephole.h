@@ -0,0 +1,41 @@
+#ifndef PEEPHOLE_H_
+#define PEEPHOLE_H_
+
+#include <iostream>
+#include <vector>
+#include "mips.h"
+
+//
+// Peephole optimizer over the method code.  Rules are applied at every
+// instruction until none of them fires; each one only looks inside a
+// straight-line stretch of code, so no rule needs to know what is live
+// across a label, a branch or a call.
+//
+// The pass runs under -O, or when COOL_PEEPHOLE is set in the
+// environment (the mycoolc --peephole option).  With COOL_PEEPHOLE set
+// it also reports how often each rule fired.
+//
+class Peephole
+{
+public:
+  typedef bool (*Apply)(std::vector<Instr> &, size_t);
+
+  struct Rule
+  {
+    const char *name;
+    Apply apply;
+  };
+
+private:
+  std::vector<unsigned long> counts;
+
+public:
+  Peephole();
+  void run(MipsCode &code);
+  void report(std::ostream &s) const;
+};
+
+bool peephole_enabled(bool optimize);
+bool peephole_report_enabled();
+
+#endif
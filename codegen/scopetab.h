@@ -0,0 +1,120 @@
+#ifndef SCOPETAB_H_
+#define SCOPETAB_H_
+
+#include <stdlib.h>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+//
+// ScopedTable is a drop-in replacement for SymbolTable that keeps every
+// visible binding in one hash map.  Each scope records the bindings it
+// introduced together with whatever they shadowed, so leaving a scope just
+// replays that undo log.  addid, lookup and probe are O(1); exitscope is
+// O(1) per binding it removes.
+//
+template <class SYM, class DAT>
+class ScopedEntry
+{
+private:
+  SYM id;
+  DAT *info;
+  DAT *shadowed_info;
+  size_t shadowed_depth;
+
+public:
+  ScopedEntry(SYM x, DAT *y, DAT *s, size_t d) : id(x), info(y), shadowed_info(s), shadowed_depth(d) {}
+
+  SYM get_id() const { return id; }
+  DAT *get_info() const { return info; }
+  DAT *get_shadowed_info() const { return shadowed_info; }
+  size_t get_shadowed_depth() const { return shadowed_depth; }
+};
+
+template <class SYM, class DAT>
+class ScopedTable
+{
+public:
+  typedef ScopedEntry<SYM, DAT> Entry;
+  typedef std::vector<Entry> Scope;
+
+private:
+  struct Binding
+  {
+    DAT *info;
+    size_t depth;
+  };
+
+  std::unordered_map<SYM, Binding> bindings;
+  std::vector<Scope> scopes;
+
+public:
+  void enterscope() { scopes.emplace_back(); }
+
+  void exitscope()
+  {
+    if (scopes.empty())
+    {
+      std::cerr << "exitscope: Can't remove scope from an empty symbol table." << std::endl;
+      exit(1);
+    }
+
+    const Scope &cur = scopes.back();
+    for (auto it = cur.rbegin(); it != cur.rend(); ++it)
+    {
+      if (it->get_shadowed_depth())
+        bindings[it->get_id()] = Binding{it->get_shadowed_info(), it->get_shadowed_depth()};
+      else
+        bindings.erase(it->get_id());
+    }
+
+    scopes.pop_back();
+  }
+
+  void addid(SYM s, DAT *i)
+  {
+    if (scopes.empty())
+    {
+      std::cerr << "addid: Can't add a symbol without a scope." << std::endl;
+      exit(1);
+    }
+
+    Binding &b = bindings[s];
+    if (b.depth)
+      scopes.back().emplace_back(s, i, b.info, b.depth);
+    else
+      scopes.back().emplace_back(s, i, (DAT *)NULL, 0);
+
+    b = Binding{i, scopes.size()};
+  }
+
+  DAT *lookup(SYM s) const
+  {
+    auto it = bindings.find(s);
+    return it == bindings.end() ? NULL : it->second.info;
+  }
+
+  DAT *probe(SYM s) const
+  {
+    auto it = bindings.find(s);
+    return (it != bindings.end() && it->second.depth == scopes.size()) ? it->second.info : NULL;
+  }
+
+  //
+  // The bindings introduced by the innermost scope, in the order they
+  // were added.
+  //
+  const Scope &current_scope() const { return scopes.back(); }
+
+  void dump() const
+  {
+    for (size_t i = scopes.size(); i-- > 0;)
+    {
+      std::cerr << "\nScope: \n";
+      for (const auto &e : scopes[i])
+        std::cerr << "  " << e.get_id() << std::endl;
+    }
+  }
+};
+
+#endif
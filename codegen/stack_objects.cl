@@ -0,0 +1,38 @@
+(*
+ * Run by "make check" with -O.  The Counter in count() never leaves its
+ * let, so it is built in count's frame; the one in keep() is returned by
+ * add and stored in an attribute, so it stays in the heap.  The program
+ * must print the lines recorded in stack_objects.out.
+ *)
+
+class Counter inherits IO {
+    n : Int <- 10;
+
+    add(k : Int) : SELF_TYPE { { n <- n + k; self; } };
+    get() : Int { n };
+    show() : Object { { out_int(n); out_string("\n"); } };
+};
+
+class Main inherits IO {
+    kept : Counter;
+
+    count(times : Int) : Int {
+        let c : Counter <- new Counter, i : Int <- 0 in
+            {
+                while i < times loop { c.add(i); i <- i + 1; } pool;
+                c.show();
+                c.get();
+            }
+    };
+
+    keep() : Object { let c : Counter <- new Counter in kept <- c.add(5) };
+
+    main() : Object {
+        {
+            out_int(count(4) + count(0));
+            out_string("\n");
+            keep();
+            kept.show();
+        }
+    };
+};
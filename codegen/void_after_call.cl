@@ -0,0 +1,24 @@
+(*
+ * Run by "make check" with -O.  reset calls back into Main, which sets x
+ * to void, so the dispatch x.foo() must still test its receiver: the
+ * program has to stop with "Dispatch to void" on line 21, as recorded in
+ * void_after_call.out.
+ *)
+
+class Holder {
+    reset(m : Main) : Object { m.clear() };
+    foo() : Int { 1 };
+};
+
+class Main inherits IO {
+    x : Holder <- new Holder;
+
+    clear() : Object { x <- let v : Holder in v };
+
+    main() : Object {
+        {
+            x.reset(self);
+            x.foo();
+        }
+    };
+};
@@ -0,0 +1,229 @@
+#ifndef BASIC_CLASSES_H_
+#define BASIC_CLASSES_H_
+
+#include "cool-tree.h"
+
+//
+// The basic classes, described once as static data.  Both semant and cgen
+// build their Object/IO/Int/Bool/String ASTs, environments and dispatch
+// tables from these tables, so the hierarchy, the method signatures and
+// the dispatch table order cannot drift between the two phases.
+//
+// There are no method bodies; they are built in to the runtime system.
+//
+
+//
+// Every name the tables use.  A phase interns basic_names once into an
+// array indexed by BasicName, and everything below refers to names by
+// index, so building the basic classes interns nothing further.
+//
+enum BasicName
+{
+  BN_Object,
+  BN_IO,
+  BN_Int,
+  BN_Bool,
+  BN_String,
+  BN_SELF_TYPE,
+  BN_no_class,
+  BN_prim_slot,
+  BN_val,
+  BN_str_field,
+  BN_abort,
+  BN_type_name,
+  BN_copy,
+  BN_out_string,
+  BN_out_int,
+  BN_in_string,
+  BN_in_int,
+  BN_length,
+  BN_concat,
+  BN_substr,
+  BN_arg,
+  BN_arg2,
+  N_BASIC_NAMES
+};
+
+static constexpr const char *basic_names[N_BASIC_NAMES] = {
+    "Object", "IO", "Int", "Bool", "String", "SELF_TYPE", "_no_class", "_prim_slot",
+    "_val", "_str_field", "abort", "type_name", "copy", "out_string", "out_int",
+    "in_string", "in_int", "length", "concat", "substr", "arg", "arg2"};
+
+#define BASIC_MAX_FORMALS 2
+#define BASIC_MAX_FEATURES 5
+#define BASIC_MAX_SLOTS 8
+
+struct BasicFormalInfo
+{
+  BasicName name;
+  BasicName type;
+};
+
+struct BasicFeatureInfo
+{
+  bool is_method;
+  BasicName name;
+  BasicName type; // attribute type, or method return type
+  int n_formals;
+  BasicFormalInfo formals[BASIC_MAX_FORMALS];
+};
+
+struct BasicClassInfo
+{
+  BasicName name;
+  BasicName parent;
+  int n_features;
+  BasicFeatureInfo features[BASIC_MAX_FEATURES];
+};
+
+static constexpr BasicClassInfo basic_class_info[] = {
+    //
+    // The Object class has no parent class. Its methods are
+    //        abort() : Object        aborts the program
+    //        type_name() : String    returns a string representation of class name
+    //        copy() : SELF_TYPE      returns a copy of the object
+    //
+    {BN_Object,
+     BN_no_class,
+     3,
+     {{true, BN_abort, BN_Object, 0, {}},
+      {true, BN_type_name, BN_String, 0, {}},
+      {true, BN_copy, BN_SELF_TYPE, 0, {}}}},
+
+    //
+    // The IO class inherits from Object. Its methods are
+    //        out_string(String) : SELF_TYPE    writes a string to the output
+    //        out_int(Int) : SELF_TYPE            "    an int    "  "     "
+    //        in_string() : String              reads a string from the input
+    //        in_int() : Int                      "   an int     "  "     "
+    //
+    {BN_IO,
+     BN_Object,
+     4,
+     {{true, BN_out_string, BN_SELF_TYPE, 1, {{BN_arg, BN_String}}},
+      {true, BN_out_int, BN_SELF_TYPE, 1, {{BN_arg, BN_Int}}},
+      {true, BN_in_string, BN_String, 0, {}},
+      {true, BN_in_int, BN_Int, 0, {}}}},
+
+    //
+    // Int and Bool have no methods and only the raw "val" slot.
+    //
+    {BN_Int, BN_Object, 1, {{false, BN_val, BN_prim_slot, 0, {}}}},
+    {BN_Bool, BN_Object, 1, {{false, BN_val, BN_prim_slot, 0, {}}}},
+
+    //
+    // The class String has a number of slots and operations:
+    //       val                                  the string's length
+    //       str_field                            the string itself
+    //       length() : Int                       length of the string
+    //       concat(arg: String) : String         string concatenation
+    //       substr(arg: Int, arg2: Int): String  substring
+    //
+    {BN_String,
+     BN_Object,
+     5,
+     {{false, BN_val, BN_Int, 0, {}},
+      {false, BN_str_field, BN_prim_slot, 0, {}},
+      {true, BN_length, BN_Int, 0, {}},
+      {true, BN_concat, BN_String, 1, {{BN_arg, BN_String}}},
+      {true, BN_substr, BN_String, 2, {{BN_arg, BN_Int}, {BN_arg2, BN_Int}}}}},
+};
+
+#define N_BASIC_CLASSES ((int)(sizeof(basic_class_info) / sizeof(basic_class_info[0])))
+
+//
+// The full layout of each basic class, inherited features included,
+// worked out at compile time.  methods is the dispatch table: slot i runs
+// feature methods[i].feature of basic class methods[i].owner.  attrs
+// lists the attributes the same way, in object field order.
+//
+struct BasicSlot
+{
+  int owner;
+  int feature;
+};
+
+struct BasicLayout
+{
+  int n_methods;
+  BasicSlot methods[BASIC_MAX_SLOTS];
+  int n_attrs;
+  BasicSlot attrs[BASIC_MAX_FEATURES];
+};
+
+constexpr const BasicFeatureInfo &basic_feature(BasicSlot slot)
+{
+  return basic_class_info[slot.owner].features[slot.feature];
+}
+
+constexpr int basic_class_index(BasicName name)
+{
+  for (int c = 0; c < N_BASIC_CLASSES; c++)
+    if (basic_class_info[c].name == name)
+      return c;
+  return -1;
+}
+
+constexpr BasicLayout basic_layout(int c)
+{
+  BasicLayout layout = {};
+  int parent = basic_class_index(basic_class_info[c].parent);
+  if (parent >= 0)
+    layout = basic_layout(parent);
+
+  for (int i = 0; i < basic_class_info[c].n_features; i++)
+  {
+    const BasicFeatureInfo &f = basic_class_info[c].features[i];
+    if (!f.is_method)
+    {
+      layout.attrs[layout.n_attrs++] = {c, i};
+      continue;
+    }
+
+    // An override keeps the slot of the method it replaces.
+    int slot = 0;
+    while (slot < layout.n_methods && basic_feature(layout.methods[slot]).name != f.name)
+      slot++;
+    layout.methods[slot] = {c, i};
+    if (slot == layout.n_methods)
+      layout.n_methods++;
+  }
+
+  return layout;
+}
+
+static constexpr BasicLayout basic_layouts[] = {basic_layout(0), basic_layout(1), basic_layout(2),
+                                                basic_layout(3), basic_layout(4)};
+
+static_assert(sizeof(basic_layouts) / sizeof(basic_layouts[0]) == N_BASIC_CLASSES,
+              "basic_layouts needs one entry per basic class");
+
+//
+// Builds the AST of one basic class from its description above.  symbols
+// holds the interned basic_names.
+//
+inline Class_ basic_class(const BasicClassInfo &info, const Symbol *symbols, Symbol filename)
+{
+  Features features = nil_Features();
+
+  for (int i = 0; i < info.n_features; i++)
+  {
+    const BasicFeatureInfo &f = info.features[i];
+
+    if (!f.is_method)
+    {
+      features = append_Features(features, single_Features(attr(symbols[f.name], symbols[f.type], no_expr())));
+      continue;
+    }
+
+    Formals formals = nil_Formals();
+    for (int j = 0; j < f.n_formals; j++)
+      formals = append_Formals(formals, single_Formals(formal(symbols[f.formals[j].name], symbols[f.formals[j].type])));
+
+    features = append_Features(features, single_Features(method(symbols[f.name], formals, symbols[f.type], no_expr())));
+  }
+
+  return class_(symbols[info.name], symbols[info.parent], features, filename);
+}
+
+#endif
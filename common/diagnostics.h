@@ -0,0 +1,128 @@
+#ifndef DIAGNOSTICS_H_
+#define DIAGNOSTICS_H_
+
+#include <stdlib.h>
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//
+// One compiler diagnostic.  The message is written through the stream
+// DiagnosticSink::report returns and ends with a newline, exactly as the
+// phases used to write it to cerr.  code names the kind of error
+// ("lexical", "syntax", "semantic").
+//
+struct Diagnostic
+{
+  std::string file;
+  int line = 0;
+  std::string code;
+  std::ostringstream message;
+  size_t seq = 0;
+};
+
+typedef void (*DiagnosticFormat)(std::ostream &, const Diagnostic &);
+
+//
+// "file:line: message".  Diagnostics that are not tied to a file are
+// printed bare.
+//
+inline void format_diagnostic(std::ostream &s, const Diagnostic &d)
+{
+  if (!d.file.empty())
+    s << d.file << ":" << d.line << ": ";
+  s << d.message.str();
+}
+
+//
+// The --max-errors limit.  The phase drivers hand options to the
+// compiler library through the environment, so the mycoolc scripts
+// export the option as COOL_MAX_ERRORS.  0 means no limit.
+//
+inline size_t diagnostic_limit(size_t fallback)
+{
+  const char *limit = getenv("COOL_MAX_ERRORS");
+  return limit ? strtoul(limit, NULL, 10) : fallback;
+}
+
+//
+// Collects diagnostics in memory and writes them out in one batch.
+// Output is ordered by file, then line, then the order diagnostics were
+// reported, so it does not depend on the order work was done in.  At
+// most max_errors diagnostics are printed.
+//
+class DiagnosticSink
+{
+private:
+  std::deque<Diagnostic> diagnostics;
+  size_t max_errors;
+  DiagnosticFormat format;
+
+public:
+  DiagnosticSink(size_t max_errors = 0, DiagnosticFormat format = format_diagnostic)
+      : max_errors(max_errors), format(format) {}
+
+  std::ostream &report(const std::string &code, const std::string &file, int line)
+  {
+    diagnostics.emplace_back();
+    Diagnostic &d = diagnostics.back();
+    d.file = file;
+    d.line = line;
+    d.code = code;
+    d.seq = diagnostics.size();
+    return d.message;
+  }
+
+  size_t size() const { return diagnostics.size(); }
+  size_t limit() const { return max_errors; }
+  // More was reported than render() prints.
+  bool limit_exceeded() const { return max_errors && diagnostics.size() > max_errors; }
+  const std::deque<Diagnostic> &entries() const { return diagnostics; }
+
+  // Moves every diagnostic of other to the end of this sink.
+  void append(DiagnosticSink &other)
+  {
+    for (Diagnostic &d : other.diagnostics)
+    {
+      diagnostics.push_back(std::move(d));
+      diagnostics.back().seq = diagnostics.size();
+    }
+    other.diagnostics.clear();
+  }
+
+  std::string render() const
+  {
+    std::vector<const Diagnostic *> sorted;
+    for (const Diagnostic &d : diagnostics)
+      sorted.push_back(&d);
+
+    std::sort(sorted.begin(), sorted.end(), [](const Diagnostic *a, const Diagnostic *b)
+              {
+                if (a->file != b->file)
+                  return a->file < b->file;
+                if (a->line != b->line)
+                  return a->line < b->line;
+                return a->seq < b->seq; });
+
+    if (max_errors && sorted.size() > max_errors)
+      sorted.resize(max_errors);
+
+    std::ostringstream out;
+    for (const Diagnostic *d : sorted)
+      format(out, *d);
+    return out.str();
+  }
+
+  void flush(std::ostream &s)
+  {
+    std::string out = render();
+    s.write(out.data(), out.size());
+    s.flush();
+    diagnostics.clear();
+  }
+};
+
+#endif
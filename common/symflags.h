@@ -0,0 +1,51 @@
+#ifndef SYMFLAGS_H_
+#define SYMFLAGS_H_
+
+#include <vector>
+#include "stringtab.h"
+
+//
+// Attribute bits for interned symbols.  Every Entry carries the dense index
+// its string table gave it, so the bits live in an array indexed by it and
+// a test is a bounds check and one load; it never builds or hashes a
+// std::string.  Entry belongs to the support code, so the bits live beside
+// it rather than inside it.
+//
+enum SymbolFlag
+{
+  SYM_BASIC_CLASS = 1 << 0,   // Object, IO, Int, Bool, String, SELF_TYPE
+  SYM_UNINHERITABLE = 1 << 1, // Int, Bool, String, SELF_TYPE
+  SYM_SELF_TYPE = 1 << 2,
+  SYM_RESERVED = 1 << 3,   // names a program may not bind: self, SELF_TYPE
+  SYM_BASIC_VALUE = 1 << 4 // Int, Bool, String: compared by value in '='
+};
+
+class SymbolFlags
+{
+private:
+  // Entry keeps its index protected.  A member pointer formed through a
+  // subclass may still be applied to any Entry.
+  struct Index : Entry
+  {
+    static int of(Symbol s) { return s->*(&Index::index); }
+  };
+
+  std::vector<unsigned char> flags;
+
+public:
+  void set(Symbol s, unsigned f)
+  {
+    size_t i = Index::of(s);
+    if (i >= flags.size())
+      flags.resize(i + 1);
+    flags[i] |= f;
+  }
+
+  bool test(Symbol s, unsigned f) const
+  {
+    size_t i = s ? Index::of(s) : flags.size();
+    return i < flags.size() && (flags[i] & f);
+  }
+};
+
+#endif
@@ -0,0 +1,249 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "timing.h"
+
+//
+// Every C++ allocation in the process goes through here so spans can
+// report how many allocations they made.  Allocations are only counted
+// once a time report or trace has been asked for; otherwise new costs a
+// load and a branch more than malloc.
+//
+static std::atomic<bool> counting(false);
+static std::atomic<unsigned long> allocations(0);
+
+void *operator new(size_t size)
+{
+  if (counting.load(std::memory_order_relaxed))
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// Microseconds.  CLOCK_MONOTONIC is shared by every process on the
+// machine, so the phases of one pipeline line up in the trace.
+// CLOCK_PROCESS_CPUTIME_ID counts every thread of the process, so a
+// phase that hands work to a thread pool is charged for all of it.
+static double clock_us(clockid_t clock)
+{
+  timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static long peak_rss_kb()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+struct PhaseTotals
+{
+  std::string name;
+  double wall_us;
+  double process_cpu_us;
+  unsigned long allocs;
+  long peak_rss_kb;
+};
+
+struct TraceEvent
+{
+  std::string name;
+  const char *category;
+  double start_us;
+  double duration_us;
+  int tid;
+};
+
+class TimeReport
+{
+private:
+  std::mutex lock;
+  std::vector<PhaseTotals> phases;
+  std::vector<TraceEvent> events;
+  const char *trace_path;
+  bool summary;
+  double wall_start;
+  double process_cpu_start;
+  unsigned long allocs_start;
+
+  void write_summary();
+  void write_trace();
+
+public:
+  bool enabled;
+
+  TimeReport();
+  void record(const char *category, std::string name, double wall_start, double process_cpu_start,
+              unsigned long allocs_start);
+  void finish();
+};
+
+static TimeReport &time_report()
+{
+  static TimeReport *report = new TimeReport();
+  return *report;
+}
+
+static thread_local int thread_id = -1;
+static std::atomic<int> next_thread_id(0);
+
+TimeReport::TimeReport() : trace_path(getenv("COOL_TRACE_FILE")),
+                           summary(getenv("COOL_TIME_REPORT") != nullptr),
+                           wall_start(clock_us(CLOCK_MONOTONIC)),
+                           process_cpu_start(clock_us(CLOCK_PROCESS_CPUTIME_ID)),
+                           allocs_start(0),
+                           enabled(summary || trace_path)
+{
+  if (!enabled)
+    return;
+
+  counting = true;
+  atexit([]
+         { time_report().finish(); });
+}
+
+void TimeReport::record(const char *category, std::string name, double wall, double process_cpu,
+                        unsigned long allocs)
+{
+  double now = clock_us(CLOCK_MONOTONIC);
+  std::lock_guard<std::mutex> guard(lock);
+
+  if (summary && std::string(category) == "phase")
+    phases.push_back(PhaseTotals{name, now - wall, clock_us(CLOCK_PROCESS_CPUTIME_ID) - process_cpu,
+                                 allocations - allocs, peak_rss_kb()});
+
+  if (trace_path)
+    events.push_back(TraceEvent{std::move(name), category, wall, now - wall, thread_id});
+}
+
+void TimeReport::finish()
+{
+  std::lock_guard<std::mutex> guard(lock);
+
+  if (summary)
+    write_summary();
+  if (trace_path)
+    write_trace();
+}
+
+void TimeReport::write_summary()
+{
+  std::ostringstream out;
+  char line[128];
+
+  out << "--- time report: " << program_invocation_short_name << " ---\n";
+  snprintf(line, sizeof(line), "%-20s %10s %11s %10s %12s\n", "phase", "wall ms", "proc cpu ms", "allocs", "peak RSS KB");
+  out << line;
+
+  for (const PhaseTotals &p : phases)
+  {
+    snprintf(line, sizeof(line), "%-20s %10.3f %11.3f %10lu %12ld\n",
+             p.name.c_str(), p.wall_us / 1e3, p.process_cpu_us / 1e3, p.allocs, p.peak_rss_kb);
+    out << line;
+  }
+
+  snprintf(line, sizeof(line), "%-20s %10.3f %11.3f %10lu %12ld\n", "total",
+           (clock_us(CLOCK_MONOTONIC) - wall_start) / 1e3,
+           (clock_us(CLOCK_PROCESS_CPUTIME_ID) - process_cpu_start) / 1e3,
+           (unsigned long)allocations - allocs_start, peak_rss_kb());
+  out << line;
+
+  std::string s = out.str();
+  fputs(s.c_str(), stderr);
+}
+
+static void write_json_string(std::ostream &out, const std::string &s)
+{
+  out << '"';
+  for (char c : s)
+  {
+    if (c == '"' || c == '\\')
+      out << '\\' << c;
+    else if ((unsigned char)c < 0x20)
+      out << ' ';
+    else
+      out << c;
+  }
+  out << '"';
+}
+
+//
+// The phases of a pipeline all append to the same file, which the
+// mycoolc scripts start with "[".  The trace-event array format allows
+// the closing bracket and a trailing comma to be left off, so each
+// process adds its events with a single O_APPEND write.
+//
+void TimeReport::write_trace()
+{
+  std::ostringstream out;
+  char number[32];
+
+  for (const TraceEvent &e : events)
+  {
+    out << "{\"name\":";
+    write_json_string(out, e.name);
+    out << ",\"cat\":\"" << e.category << "\",\"ph\":\"X\"";
+    snprintf(number, sizeof(number), "%.3f", e.start_us);
+    out << ",\"ts\":" << number;
+    snprintf(number, sizeof(number), "%.3f", e.duration_us);
+    out << ",\"dur\":" << number;
+    out << ",\"pid\":" << getpid() << ",\"tid\":" << e.tid << ",\"args\":{\"process\":";
+    write_json_string(out, program_invocation_short_name);
+    out << "}},\n";
+  }
+
+  std::string s = out.str();
+  int fd = open(trace_path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (fd < 0)
+    return;
+  if (write(fd, s.data(), s.size()) < 0)
+    perror(trace_path);
+  close(fd);
+}
+
+bool time_report_enabled()
+{
+  return time_report().enabled;
+}
+
+TimeSpan::TimeSpan(const char *category, const char *name, const char *detail)
+    : category(category), name(name), detail(detail), active(time_report_enabled())
+{
+  if (!active)
+    return;
+
+  if (thread_id < 0)
+    thread_id = next_thread_id++;
+
+  wall_start = clock_us(CLOCK_MONOTONIC);
+  process_cpu_start = clock_us(CLOCK_PROCESS_CPUTIME_ID);
+  allocs_start = allocations;
+}
+
+TimeSpan::~TimeSpan()
+{
+  if (!active)
+    return;
+
+  std::string full_name = name;
+  if (detail)
+    full_name += std::string(".") + detail;
+
+  time_report().record(category, std::move(full_name), wall_start, process_cpu_start, allocs_start);
+}
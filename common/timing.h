@@ -0,0 +1,39 @@
+#ifndef TIMING_H_
+#define TIMING_H_
+
+//
+// --time-report instrumentation.  The option reaches the phases as
+// COOL_TIME_REPORT (summary on stderr) and COOL_TRACE_FILE (Chrome
+// trace-event file); see the mycoolc scripts.
+//
+// A TimeSpan measures the scope it lives in.  Spans nest per thread.
+// When the process exits, every span in the "phase" category gets a line
+// with its wall time, the CPU time of the whole process (type checking
+// runs on a thread pool, so this is more than the span's own thread
+// used), its allocation count and peak RSS, and every span is appended
+// to the trace file as a complete ("X") event.  With neither variable set
+// a TimeSpan costs one test of a cached flag and nothing is counted.
+//
+// One copy of timing.cc and timing.h lives in common/ and every phase's
+// Makefile builds it from there.
+//
+class TimeSpan
+{
+private:
+  const char *category;
+  const char *name;
+  const char *detail;
+  bool active;
+  double wall_start;
+  double process_cpu_start;
+  unsigned long allocs_start;
+
+public:
+  // The span is called name, or "name.detail" when detail is given.
+  TimeSpan(const char *category, const char *name, const char *detail = nullptr);
+  ~TimeSpan();
+};
+
+bool time_report_enabled();
+
+#endif
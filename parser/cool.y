@@ -7,6 +7,8 @@
 #include "cool-tree.h"
 #include "stringtab.h"
 #include "utilities.h"
+#include "diagnostics.h"
+#include "timing.h"
 
 /* Set the size of the parser stack to be sufficient large to accomodate
    our tests.  There seems to be some problem with Bison's dynamic
@@ -80,6 +82,13 @@ extern int yylex();           /*  the entry point to the lexer  */
 Program ast_root;	      /* the result of the parse  */
 Classes parse_results;        /* for use in semantic analysis */
 int omerrs = 0;               /* number of erros in lexing and parsing */
+
+/* The parser proper is generated as parse_program; cool_yyparse (defined
+   below) wraps it so buffered diagnostics are written before the driver
+   looks at omerrs. */
+#undef yyparse
+#define yyparse parse_program
+int parse_program();
 %}
 
 /* A union of all the types that can be the result of parsing actions. */
@@ -307,15 +316,77 @@ expr_list
 /* end of grammar */
 %%
 
+/* Parse errors are printed as "file", line N: message. */
+static void format_parse_error(std::ostream &s, const Diagnostic &d)
+{
+  s << "\"" << d.file << "\", line " << d.line << ": " << d.message.str();
+}
+
+/* Lexical errors arrive as ERROR tokens and syntax errors from Bison;
+   both are collected here.  --max-errors N stops at the first error past
+   N and prints the first N.  Without it the parser behaves as it always
+   has: it prints the 51st error too and stops with "More than 50
+   errors". */
+static DiagnosticSink diagnostics(diagnostic_limit(0), format_parse_error);
+static const bool default_limit = !getenv("COOL_MAX_ERRORS");
+
+/* Same text as print_cool_token, written to a stream instead of cerr. */
+static void write_cool_token(std::ostream &s, int tok)
+{
+  s << cool_token_to_string(tok);
+
+  switch (tok) {
+  case (STR_CONST):
+    s << " = " << " \"";
+    print_escaped_string(s, cool_yylval.symbol->get_string());
+    s << "\"";
+    break;
+  case (INT_CONST):
+  case (TYPEID):
+  case (OBJECTID):
+    s << " = " << cool_yylval.symbol;
+    break;
+  case (BOOL_CONST):
+    s << (cool_yylval.boolean ? " = true" : " = false");
+    break;
+  case (ERROR):
+    s << " = ";
+    print_escaped_string(s, cool_yylval.error_msg);
+    break;
+  }
+}
+
 /* This function is called automatically when Bison detects a parse error. */
 void yyerror(const char *s)
 {
   extern int curr_lineno;
 
-  std::cerr << "\"" << curr_filename << "\", line " << curr_lineno << ": " \
-    << s << " at or near ";
-  print_cool_token(yychar);
-  std::cerr << std::endl;
+  std::ostream &msg = diagnostics.report(yychar == ERROR ? "lexical" : "syntax",
+                                         curr_filename, curr_lineno);
+  msg << s << " at or near ";
+  write_cool_token(msg, yychar);
+  msg << "\n";
+
   omerrs++;
-  if(omerrs>50) { std::cerr << "More than 50 errors" << std::endl; exit(1);}
+  if (default_limit && omerrs > 50) {
+    diagnostics.flush(std::cerr);
+    std::cerr << "More than 50 errors" << std::endl;
+    exit(1);
+  }
+  if (diagnostics.limit_exceeded()) {
+    diagnostics.flush(std::cerr);
+    std::cerr << "Stopped after " << diagnostics.limit() << " errors" << std::endl;
+    exit(1);
+  }
+}
+
+int cool_yyparse()
+{
+  int result;
+  {
+    TimeSpan span("phase", "parse");
+    result = parse_program();
+  }
+  diagnostics.flush(std::cerr);
+  return result;
 }
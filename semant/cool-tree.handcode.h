@@ -2,6 +2,7 @@
 #define COOL_TREE_HANDCODE_H
 
 #include <iostream>
+#include <vector>
 #include "tree.h"
 #include "stringtab.h"
 #define yylineno curr_lineno
@@ -47,6 +48,7 @@ typedef list_node<Expression> Expressions_class;
 typedef Expressions_class *Expressions;
 typedef list_node<Case> Cases_class;
 typedef Cases_class *Cases;
+typedef std::vector<Expression> ExprList;
 
 #define Program_EXTRAS       \
   virtual void semant() = 0; \
@@ -114,12 +116,14 @@ typedef Cases_class *Cases;
   virtual Symbol get_branch_name() = 0;     \
   virtual Symbol get_branch_type() = 0;     \
   virtual Expression get_branch_expr() = 0; \
+  virtual void flatten(ExprList &) = 0;     \
   virtual void dump_with_types(ostream &, int) = 0;
 
 #define branch_EXTRAS                             \
   Symbol get_branch_name() { return name; };      \
   Symbol get_branch_type() { return type_decl; }; \
   Expression get_branch_expr() { return expr; };  \
+  void flatten(ExprList &);                       \
   void dump_with_types(ostream &, int);
 
 #define Expression_EXTRAS                                                                     \
@@ -133,10 +137,12 @@ typedef Cases_class *Cases;
   virtual void dump_with_types(ostream &, int) = 0;                                           \
   inline virtual Boolean is_no_expr() { return false; }                                       \
   virtual Symbol type_check(Class_ cur_class, ClassTableP class_table, EnvironmentP env) = 0; \
+  virtual void flatten(ExprList &) = 0;                                                       \
   void dump_type(ostream &, int);                                                             \
   Expression_class() { type = (Symbol)NULL; }
 
 #define Expression_SHARED_EXTRAS \
+  void flatten(ExprList &); \
   void dump_with_types(ostream &, int);
 
 #define assign_EXTRAS \
@@ -2,8 +2,17 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 #include "semant.h"
+#include "semant_cache.h"
+#include "symflags.h"
+#include "timing.h"
 #include "utilities.h"
 
 extern int semant_debug;
@@ -48,58 +57,87 @@ static Symbol
     substr,
     type_name,
     val;
+
+// basic_names, interned; indexed by BasicName.
+static Symbol basic_symbols[N_BASIC_NAMES];
 //
 // Initializing the predefined symbols.
 //
 static void initialize_constants(void)
 {
-  arg = idtable.add_string("arg");
-  arg2 = idtable.add_string("arg2");
-  Bool = idtable.add_string("Bool");
-  concat = idtable.add_string("concat");
-  cool_abort = idtable.add_string("abort");
-  ::copy = idtable.add_string("copy");
-  Int = idtable.add_string("Int");
-  in_int = idtable.add_string("in_int");
-  in_string = idtable.add_string("in_string");
-  IO = idtable.add_string("IO");
+  // The basic class names are interned once, and the constants below
+  // that name one of them share its symbol.
+  for (int i = 0; i < N_BASIC_NAMES; i++)
+    basic_symbols[i] = idtable.add_string((char *)basic_names[i]);
+
+  arg = basic_symbols[BN_arg];
+  arg2 = basic_symbols[BN_arg2];
+  Bool = basic_symbols[BN_Bool];
+  concat = basic_symbols[BN_concat];
+  cool_abort = basic_symbols[BN_abort];
+  ::copy = basic_symbols[BN_copy];
+  Int = basic_symbols[BN_Int];
+  in_int = basic_symbols[BN_in_int];
+  in_string = basic_symbols[BN_in_string];
+  IO = basic_symbols[BN_IO];
   isProto = idtable.add_string("isProto");
-  length = idtable.add_string("length");
+  length = basic_symbols[BN_length];
   Main = idtable.add_string("Main");
   main_meth = idtable.add_string("main");
   //   _no_class is a symbol that can't be the name of any
   //   user-defined class.
-  No_class = idtable.add_string("_no_class");
+  No_class = basic_symbols[BN_no_class];
   No_type = idtable.add_string("_no_type");
   // _BOTTOM_ is the symbol for the bottom of the lattice of types
   _BOTTOM_ = idtable.add_string("_bottom");
-  Object = idtable.add_string("Object");
-  out_int = idtable.add_string("out_int");
-  out_string = idtable.add_string("out_string");
-  prim_slot = idtable.add_string("_prim_slot");
+  Object = basic_symbols[BN_Object];
+  out_int = basic_symbols[BN_out_int];
+  out_string = basic_symbols[BN_out_string];
+  prim_slot = basic_symbols[BN_prim_slot];
   self = idtable.add_string("self");
-  SELF_TYPE = idtable.add_string("SELF_TYPE");
-  Str = idtable.add_string("String");
-  str_field = idtable.add_string("_str_field");
-  substr = idtable.add_string("substr");
-  type_name = idtable.add_string("type_name");
-  val = idtable.add_string("_val");
+  SELF_TYPE = basic_symbols[BN_SELF_TYPE];
+  Str = basic_symbols[BN_String];
+  str_field = basic_symbols[BN_str_field];
+  substr = basic_symbols[BN_substr];
+  type_name = basic_symbols[BN_type_name];
+  val = basic_symbols[BN_val];
+}
+
+static SymbolFlags symbol_flags;
+
+static void initialize_symbol_flags(void)
+{
+  symbol_flags.set(Object, SYM_BASIC_CLASS);
+  symbol_flags.set(IO, SYM_BASIC_CLASS);
+  symbol_flags.set(Int, SYM_BASIC_CLASS | SYM_UNINHERITABLE | SYM_BASIC_VALUE);
+  symbol_flags.set(Bool, SYM_BASIC_CLASS | SYM_UNINHERITABLE | SYM_BASIC_VALUE);
+  symbol_flags.set(Str, SYM_BASIC_CLASS | SYM_UNINHERITABLE | SYM_BASIC_VALUE);
+  symbol_flags.set(SELF_TYPE, SYM_BASIC_CLASS | SYM_UNINHERITABLE | SYM_SELF_TYPE | SYM_RESERVED);
+  symbol_flags.set(self, SYM_RESERVED);
 }
 
-static const std::unordered_set<std::string> basic_classes = {"Object", "IO", "Int", "Bool", "String", "SELF_TYPE"};
-static const std::unordered_set<std::string> uninheritable = {"Int", "Bool", "String", "SELF_TYPE"};
-static const std::unordered_set<std::string> eq_type_set = {"Int", "Bool", "String"};
+//
+// Set while a worker thread is type checking a class; semant_error reports
+// into it instead of the class table's sink.
+//
+static thread_local DiagnosticSink *class_diagnostics = nullptr;
+
+//
+// Set while a class is type checked for the incremental cache; every
+// class the checker looks up is recorded as a dependency of that class.
+//
+static thread_local std::set<Symbol> *class_dependencies = nullptr;
 
 Symbol assign_class::type_check(Class_ cur_class, ClassTableP class_table, EnvironmentP env)
 {
   Symbol t_prime = this->expr->type_check(cur_class, class_table, env);
   Symbol id = this->name;
 
-  if (id == self)
+  if (symbol_flags.test(id, SYM_RESERVED))
     class_table->semant_error(cur_class->get_filename(), this) << "Cannot assign to 'self'." << endl;
 
   Symbol t = env->_objects->lookup(id);
-  if (t || id == self)
+  if (t || symbol_flags.test(id, SYM_RESERVED))
   {
     if (!(class_table->leq(t, t_prime, cur_class->get_name())))
       class_table->semant_error(cur_class->get_filename(), this) << "Type " << t_prime << " of assigned expression does not conform to declared type " << t << " of identifier " << id << "." << endl;
@@ -123,7 +161,7 @@ Symbol static_dispatch_class::type_check(Class_ cur_class, ClassTableP class_tab
   for (int i = actual_ls->first(); actual_ls->more(i); i = actual_ls->next(i))
     actual_types.emplace_back(actual_ls->nth(i)->type_check(cur_class, class_table, env));
 
-  if (t == SELF_TYPE)
+  if (symbol_flags.test(t, SYM_SELF_TYPE))
   {
     class_table->semant_error(cur_class->get_filename(), this) << "Static dispatch to SELF_TYPE." << endl;
     this->type = _BOTTOM_;
@@ -166,7 +204,7 @@ Symbol static_dispatch_class::type_check(Class_ cur_class, ClassTableP class_tab
   }
 
   Symbol t_n_plus_one_prime = formal_types->at(formal_types->size() - 1);
-  Symbol t_n_plus_one = (t_n_plus_one_prime == SELF_TYPE) ? t_zero : t_n_plus_one_prime;
+  Symbol t_n_plus_one = symbol_flags.test(t_n_plus_one_prime, SYM_SELF_TYPE) ? t_zero : t_n_plus_one_prime;
 
   this->set_type(t_n_plus_one);
   return t_n_plus_one;
@@ -183,7 +221,7 @@ Symbol dispatch_class::type_check(Class_ cur_class, ClassTableP class_table, Env
     actual_types.emplace_back(actual_ls->nth(i)->type_check(cur_class, class_table, env));
 
   Symbol t_zero_prime = t_zero;
-  if (t_zero == SELF_TYPE)
+  if (symbol_flags.test(t_zero, SYM_SELF_TYPE))
     t_zero_prime = cur_class->get_name();
 
   if (t_zero_prime == _BOTTOM_)
@@ -220,7 +258,7 @@ Symbol dispatch_class::type_check(Class_ cur_class, ClassTableP class_table, Env
   }
 
   Symbol t_n_plus_one_prime = formal_types->at(formal_types->size() - 1);
-  Symbol t_n_plus_one = (t_n_plus_one_prime == SELF_TYPE) ? t_zero : t_n_plus_one_prime;
+  Symbol t_n_plus_one = symbol_flags.test(t_n_plus_one_prime, SYM_SELF_TYPE) ? t_zero : t_n_plus_one_prime;
 
   this->set_type(t_n_plus_one);
   return t_n_plus_one;
@@ -264,14 +302,14 @@ Symbol typcase_class::type_check(Class_ cur_class, ClassTableP class_table, Envi
     Symbol c_name = c->get_branch_name();
     Symbol c_type = c->get_branch_type();
 
-    if (c_name == self)
+    if (symbol_flags.test(c_name, SYM_RESERVED))
       class_table->semant_error(cur_class->get_filename(), c) << "'self' bound in 'case'." << endl;
-    if (c_type == SELF_TYPE)
+    if (symbol_flags.test(c_type, SYM_SELF_TYPE))
       class_table->semant_error(cur_class->get_filename(), c) << "Identifier " << c_name << " declared with type SELF_TYPE in case branch." << endl;
 
     if (unique_types.count(c_type))
       class_table->semant_error(cur_class->get_filename(), c) << "Duplicate branch " << c_type << " in case statement." << endl;
-    if (c_type != SELF_TYPE && !class_table->lookup(c_type))
+    if (!symbol_flags.test(c_type, SYM_SELF_TYPE) && !class_table->lookup(c_type))
       class_table->semant_error(cur_class->get_filename(), c) << "Class " << c_type << " of case branch is undefined." << endl;
 
     unique_types.insert(c_type);
@@ -315,10 +353,10 @@ Symbol let_class::type_check(Class_ cur_class, ClassTableP class_table, Environm
   Symbol id = this->identifier;
   Symbol t_zero = this->type_decl;
 
-  if (id == self)
+  if (symbol_flags.test(id, SYM_RESERVED))
     class_table->semant_error(cur_class->get_filename(), this) << "'self' cannot be bound in a 'let' expression." << endl;
 
-  Boolean type_exists = (class_table->lookup(t_zero)) || t_zero == SELF_TYPE;
+  Boolean type_exists = (class_table->lookup(t_zero)) || symbol_flags.test(t_zero, SYM_SELF_TYPE);
 
   if (!type_exists)
     class_table->semant_error(cur_class->get_filename(), this) << "Class " << t_zero << " of let-bound identifier " << id << " is undefined." << endl;
@@ -410,7 +448,7 @@ Symbol eq_class::type_check(Class_ cur_class, ClassTableP class_table, Environme
 {
   Symbol t_one = this->e1->type_check(cur_class, class_table, env);
   Symbol t_two = this->e2->type_check(cur_class, class_table, env);
-  if (eq_type_set.count(t_one->get_string()) || eq_type_set.count(t_two->get_string()))
+  if (symbol_flags.test(t_one, SYM_BASIC_VALUE) || symbol_flags.test(t_two, SYM_BASIC_VALUE))
   {
     if (t_one != t_two)
       class_table->semant_error(cur_class->get_filename(), this) << "Illegal comparison with a basic type." << endl;
@@ -464,7 +502,7 @@ Symbol new__class::type_check(Class_ cur_class, ClassTableP class_table, Environ
 {
   Symbol t = this->type_name;
 
-  if (t != SELF_TYPE && !class_table->lookup(t))
+  if (!symbol_flags.test(t, SYM_SELF_TYPE) && !class_table->lookup(t))
   {
     class_table->semant_error(cur_class->get_filename(), this) << "'new' used with undefined class " << t << "." << endl;
     t = _BOTTOM_;
@@ -513,7 +551,7 @@ void method_class::type_check(Class_ cur_class, ClassTableP class_table, Environ
     Symbol t = cur->get_type_dec();
     Symbol name = cur->get_name();
 
-    if (t != SELF_TYPE && !class_table->lookup(t))
+    if (!symbol_flags.test(t, SYM_SELF_TYPE) && !class_table->lookup(t))
       class_table->semant_error(cur_class->get_filename(), this) << "Class " << t << " of formal parameter " << name << " is undefined." << endl;
 
     env->_objects->addid(name, t);
@@ -523,7 +561,7 @@ void method_class::type_check(Class_ cur_class, ClassTableP class_table, Environ
   Symbol t_zero_prime = this->expr->type_check(cur_class, class_table, env);
   Symbol t_zero = this->return_type;
 
-  if (t_zero != SELF_TYPE && !class_table->lookup(t_zero))
+  if (!symbol_flags.test(t_zero, SYM_SELF_TYPE) && !class_table->lookup(t_zero))
   {
     class_table->semant_error(cur_class->get_filename(), this) << "Undefined return type " << t_zero << " in method " << this->get_name() << "." << endl;
   }
@@ -539,7 +577,7 @@ void attr_class::type_check(Class_ cur_class, ClassTableP class_table, Environme
 {
   Expression e_one = this->get_expr();
   Symbol t_zero = this->get_type_dec();
-  Boolean type_exists = (class_table->lookup(t_zero)) || t_zero == SELF_TYPE;
+  Boolean type_exists = (class_table->lookup(t_zero)) || symbol_flags.test(t_zero, SYM_SELF_TYPE);
 
   if (!type_exists)
     class_table->semant_error(cur_class->get_filename(), this) << "Class " << t_zero << " of attribute " << this->get_name() << " is undefined." << endl;
@@ -559,18 +597,290 @@ void attr_class::type_check(Class_ cur_class, ClassTableP class_table, Environme
   }
 }
 
+static void type_check_class(InheritanceNodeP c_node, ClassTableP c)
+{
+  Class_ cur = c_node->_ref;
+  TimeSpan span("class", cur->get_name()->get_string());
+  Features c_features = cur->get_features();
+
+  for (int i = c_features->first(); c_features->more(i); i = c_features->next(i))
+  {
+    Feature f = c_features->nth(i);
+    TimeSpan feature_span(f->is_attr() ? "attr" : "method", cur->get_name()->get_string(), f->get_name()->get_string());
+    f->type_check(cur, c, c_node->_env);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Incremental type checking
+//
+// When COOL_SEMANT_CACHE names a file, each class is fingerprinted from
+// its untyped AST, its own environment, and the inheritance chain and
+// method signatures of every class it looked up the last time it was
+// checked.  A class whose fingerprint is unchanged gets its annotations
+// and diagnostics back from the cache instead of going through
+// type_check.
+//
+//////////////////////////////////////////////////////////////////////
+
+//
+// Class names resolved once on the main thread, so workers never need
+// to touch idtable.
+//
+struct ClassIndex
+{
+  std::unordered_map<std::string, InheritanceNodeP> nodes;
+  std::unordered_map<std::string, Symbol> types;
+};
+
+static ExprList flatten_class(Class_ c)
+{
+  ExprList exprs;
+  Features features = c->get_features();
+
+  for (int i = features->first(); features->more(i); i = features->next(i))
+    features->nth(i)->get_expr()->flatten(exprs);
+
+  return exprs;
+}
+
+//
+// Only the method tables of other classes are stable while workers run;
+// their object tables gain and lose scopes as they are checked, so
+// attributes are included just for the class being fingerprinted.
+//
+static void class_signature(std::ostream &s, InheritanceNodeP c_node, Boolean with_attrs)
+{
+  for (InheritanceNodeP p = c_node; p; p = p->_parent)
+    s << p->_ref->get_name() << " ";
+  s << "\n";
+
+  for (const auto &method : c_node->_env->_methods->current_scope())
+  {
+    s << method.get_id() << "(";
+    for (Symbol t : *(method.get_info()))
+      s << t << " ";
+    s << ") ";
+  }
+  s << "\n";
+
+  if (with_attrs)
+  {
+    for (const auto &obj : c_node->_env->_objects->current_scope())
+      s << obj.get_id() << ":" << obj.get_info() << " ";
+    s << "\n";
+  }
+}
+
+static std::string class_fingerprint(InheritanceNodeP c_node, const std::string &ast,
+                                     const std::vector<std::string> &deps, const ClassIndex &index)
+{
+  std::ostringstream s;
+  s << ast;
+  class_signature(s, c_node, true);
+
+  for (const std::string &dep : deps)
+  {
+    s << dep << ": ";
+    auto it = index.nodes.find(dep);
+    if (it != index.nodes.end())
+      class_signature(s, it->second, false);
+    else
+      s << "undefined\n";
+  }
+
+  return content_hash(s.str());
+}
+
+static Boolean restore_types(Class_ c, const std::vector<std::string> &names, const ClassIndex &index)
+{
+  ExprList exprs = flatten_class(c);
+  if (exprs.size() != names.size())
+    return false;
+
+  TypeList types;
+  for (const std::string &name : names)
+  {
+    if (name.empty())
+    {
+      types.push_back(NULL);
+      continue;
+    }
+
+    auto it = index.types.find(name);
+    if (it == index.types.end())
+      return false;
+    types.push_back(it->second);
+  }
+
+  for (size_t i = 0; i < exprs.size(); i++)
+    exprs[i]->set_type(types[i]);
+  return true;
+}
+
+static std::string cache_key(Class_ c)
+{
+  return std::string(c->get_filename()->get_string()) + ":" + c->get_name()->get_string();
+}
+
+//
+// Diagnostics are cached as (file, line, code, message) quadruples.
+//
+static void save_diagnostics(const DiagnosticSink &diag, std::vector<std::string> &out)
+{
+  for (const Diagnostic &d : diag.entries())
+  {
+    out.push_back(d.file);
+    out.push_back(std::to_string(d.line));
+    out.push_back(d.code);
+    out.push_back(d.message.str());
+  }
+}
+
+static void load_diagnostics(const std::vector<std::string> &in, DiagnosticSink &diag)
+{
+  for (size_t i = 0; i + 3 < in.size(); i += 4)
+    diag.report(in[i + 2], in[i], atoi(in[i + 1].c_str())) << in[i + 3];
+}
+
+static void type_check_cached(InheritanceNodeP c_node, ClassTableP c, const ClassCache &cache,
+                              const ClassIndex &index, DiagnosticSink &diag, ClassCacheEntry &result)
+{
+  Class_ cur = c_node->_ref;
+  std::ostringstream ast;
+  cur->dump_with_types(ast, 0);
+
+  const ClassCacheEntry *cached = cache.find(cache_key(cur));
+  if (cached && cached->fingerprint == class_fingerprint(c_node, ast.str(), cached->deps, index) &&
+      restore_types(cur, cached->types, index))
+  {
+    load_diagnostics(cached->diagnostics, diag);
+    return;
+  }
+
+  std::set<Symbol> deps;
+  class_dependencies = &deps;
+  type_check_class(c_node, c);
+  class_dependencies = nullptr;
+
+  for (Symbol dep : deps)
+    result.deps.push_back(dep->get_string());
+  std::sort(result.deps.begin(), result.deps.end());
+
+  for (Expression e : flatten_class(cur))
+    result.types.push_back(e->get_type() ? e->get_type()->get_string() : "");
+
+  result.fingerprint = class_fingerprint(c_node, ast.str(), result.deps, index);
+  save_diagnostics(diag, result.diagnostics);
+}
+
+//
+// Once environments are percolated each class only reads the class table
+// and mutates its own environment and AST, so classes are checked on a
+// pool of threads.  Diagnostics are buffered per class and merged in table
+// order, which keeps the output identical to a serial run.
+//
+// With --max-errors, checking stops at the first class that brings the
+// running total, counted in table order, up to the limit.  stop_at only
+// moves once every class before it is done, so which classes get
+// reported never depends on thread timing.
+//
 void type_check(ClassTableP c)
 {
+  TimeSpan span("phase", "type_check");
+  std::vector<InheritanceNodeP> nodes;
   for (const auto &cur : c->gettable().front())
   {
-    if (basic_classes.count(cur.get_id()->get_string()))
+    if (symbol_flags.test(cur.get_id(), SYM_BASIC_CLASS))
       continue;
 
-    InheritanceNodeP c_node = cur.get_info();
-    Features c_features = c_node->_ref->get_features();
+    nodes.push_back(cur.get_info());
+  }
+
+  const char *cache_path = getenv("COOL_SEMANT_CACHE");
+  ClassCache *cache = cache_path ? new ClassCache(cache_path) : nullptr;
+  ClassIndex index;
+  std::vector<ClassCacheEntry> results(nodes.size());
 
-    for (int i = c_features->first(); c_features->more(i); i = c_features->next(i))
-      c_features->nth(i)->type_check(c_node->_ref, c, c_node->_env);
+  if (cache)
+  {
+    for (const auto &cur : c->gettable().front())
+    {
+      index.nodes[cur.get_id()->get_string()] = cur.get_info();
+      index.types[cur.get_id()->get_string()] = cur.get_id();
+    }
+    index.types[SELF_TYPE->get_string()] = SELF_TYPE;
+    index.types[_BOTTOM_->get_string()] = _BOTTOM_;
+    index.types[No_type->get_string()] = No_type;
+  }
+
+  ClassDiagnosticsList diagnostics(nodes.size());
+  std::atomic<size_t> next_class(0);
+
+  size_t limit = c->error_limit();
+  std::atomic<size_t> stop_at(limit && (size_t)c->errors() >= limit ? 0 : nodes.size());
+  std::mutex frontier_lock;
+  std::vector<Boolean> done(nodes.size(), false);
+  size_t frontier = 0;
+  size_t reported = c->errors();
+
+  auto finish = [&](size_t i)
+  {
+    std::lock_guard<std::mutex> guard(frontier_lock);
+    done[i] = true;
+
+    while (frontier < nodes.size() && done[frontier] && reported < limit)
+    {
+      reported += diagnostics[frontier++].size();
+      if (reported >= limit)
+        stop_at = std::min<size_t>(stop_at, frontier);
+    }
+  };
+
+  auto worker = [&]()
+  {
+    for (size_t i = next_class++; i < stop_at; i = next_class++)
+    {
+      class_diagnostics = &diagnostics[i];
+      if (cache)
+        type_check_cached(nodes[i], c, *cache, index, diagnostics[i], results[i]);
+      else
+        type_check_class(nodes[i], c);
+
+      if (limit)
+        finish(i);
+    }
+    class_diagnostics = nullptr;
+  };
+
+  size_t n_threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), nodes.size());
+  std::vector<std::thread> pool;
+  for (size_t i = 1; i < n_threads; i++)
+    pool.emplace_back(worker);
+
+  worker();
+
+  for (std::thread &t : pool)
+    t.join();
+
+  c->merge_diagnostics(diagnostics, stop_at);
+  if (stop_at < nodes.size())
+    c->mark_cut_short();
+
+  if (cache)
+  {
+    // A hit leaves its result empty and keeps the old entry.  Classes past
+    // the error limit were never looked up, but they are still part of the
+    // program, so their entries are kept as well.
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+      if (!results[i].fingerprint.empty())
+        cache->store(cache_key(nodes[i]->_ref), results[i]);
+      else
+        cache->keep(cache_key(nodes[i]->_ref));
+    }
+    cache->save();
   }
 }
 
@@ -580,11 +890,11 @@ Symbol ClassTable::lub(Symbol type_one, Symbol type_two, Symbol C)
     return type_two;
   if (type_two == No_type || type_two == _BOTTOM_)
     return type_one;
-  if (type_one == SELF_TYPE && type_two == SELF_TYPE)
+  if (symbol_flags.test(type_one, SYM_SELF_TYPE) && symbol_flags.test(type_two, SYM_SELF_TYPE))
     return SELF_TYPE;
-  if (type_one == SELF_TYPE)
+  if (symbol_flags.test(type_one, SYM_SELF_TYPE))
     type_one = C;
-  if (type_two == SELF_TYPE)
+  if (symbol_flags.test(type_two, SYM_SELF_TYPE))
     type_two = C;
 
   InheritanceNodeP node_one = this->lookup(type_one);
@@ -607,15 +917,22 @@ Symbol ClassTable::lub(Symbol type_one, Symbol type_two, Symbol C)
   return Object;
 }
 
+InheritanceNodeP ClassTable::lookup(Symbol name)
+{
+  if (class_dependencies)
+    class_dependencies->insert(name);
+  return SymbolTable<Symbol, InheritanceNode>::lookup(name);
+}
+
 Boolean ClassTable::leq(Symbol ancestor, Symbol child, Symbol C)
 {
   if (child == _BOTTOM_ || child == No_type)
     return true;
-  if (ancestor == SELF_TYPE && child == SELF_TYPE)
+  if (symbol_flags.test(ancestor, SYM_SELF_TYPE) && symbol_flags.test(child, SYM_SELF_TYPE))
     return true;
-  if (ancestor == SELF_TYPE)
+  if (symbol_flags.test(ancestor, SYM_SELF_TYPE))
     return false;
-  if (child == SELF_TYPE)
+  if (symbol_flags.test(child, SYM_SELF_TYPE))
     child = C;
 
   InheritanceNodeP ancestor_node = this->lookup(ancestor);
@@ -627,11 +944,20 @@ Boolean ClassTable::leq(Symbol ancestor, Symbol child, Symbol C)
   return true;
 }
 
+//
+// Writes every collected diagnostic at once and stops if there were any.
+//
 void ClassTable::error_out()
 {
   if (this->errors())
   {
-    cerr << "Compilation halted due to static semantic errors." << endl;
+    std::string out = diagnostics.render();
+    if (cut_short || diagnostics.limit_exceeded())
+      out += "Stopped after " + std::to_string(diagnostics.limit()) + " errors.\n";
+    out += "Compilation halted due to static semantic errors.\n";
+
+    error_stream.write(out.data(), out.size());
+    error_stream.flush();
     exit(1);
   }
 }
@@ -668,7 +994,7 @@ ObjectTableP ClassTable::clone_objects(ObjectTableP cur)
   ObjectTableP ret = new ObjectTable;
   ret->enterscope();
 
-  for (const auto &obj : cur->gettable().front())
+  for (const auto &obj : cur->current_scope())
     ret->addid(obj.get_id(), obj.get_info());
 
   return ret;
@@ -679,7 +1005,7 @@ MethodTableP ClassTable::clone_methods(MethodTableP cur)
   MethodTableP ret = new MethodTable;
   ret->enterscope();
 
-  for (const auto &method : cur->gettable().front())
+  for (const auto &method : cur->current_scope())
   {
     TypeListP new_val = new TypeList();
 
@@ -692,14 +1018,43 @@ MethodTableP ClassTable::clone_methods(MethodTableP cur)
   return ret;
 }
 
-void ClassTable::percolate_env(InheritanceNodeP cur)
+//
+// The basic classes can neither be redefined nor fail any of the checks
+// populate_env makes, so their environments are filled straight from the
+// precomputed layouts in basic_classes.h.  Only user classes are cloned
+// from their parent and populated from their features.
+//
+void ClassTable::seed_basic_env(InheritanceNodeP c_node, const BasicLayout &layout)
 {
-  populate_env(cur);
+  for (int i = 0; i < layout.n_attrs; i++)
+  {
+    const BasicFeatureInfo &f = basic_feature(layout.attrs[i]);
+    c_node->_env->_objects->addid(basic_symbols[f.name], basic_symbols[f.type]);
+  }
+
+  for (int i = 0; i < layout.n_methods; i++)
+  {
+    const BasicFeatureInfo &f = basic_feature(layout.methods[i]);
+    TypeListP type_list = new TypeList();
+
+    for (int j = 0; j < f.n_formals; j++)
+      type_list->push_back(basic_symbols[f.formals[j].type]);
+    type_list->push_back(basic_symbols[f.type]);
+
+    c_node->_env->_methods->addid(basic_symbols[f.name], type_list);
+  }
+}
 
+void ClassTable::percolate_env(InheritanceNodeP cur)
+{
   for (InheritanceNodeP child : *(cur->_children))
   {
+    if (symbol_flags.test(child->_ref->get_name(), SYM_BASIC_CLASS))
+      continue;
+
     child->_env->_objects = clone_objects(cur->_env->_objects);
     child->_env->_methods = clone_methods(cur->_env->_methods);
+    populate_env(child);
     percolate_env(child);
   }
 }
@@ -725,7 +1080,7 @@ void ClassTable::populate_env(InheritanceNodeP c_node)
 
 void ClassTable::process_attr(InheritanceNodeP c_node, Symbol attr_name, Feature attr)
 {
-  if (attr_name == self)
+  if (symbol_flags.test(attr_name, SYM_RESERVED))
   {
     semant_error(c_node->_ref->get_filename(), attr) << "'self' cannot be the name of an attribute." << endl;
     return;
@@ -805,9 +1160,9 @@ TypeListP ClassTable::create_method_type_list(Class_ c, Symbol method_name, Feat
 
     if (formal_ids.count(f_name))
       semant_error(c->get_filename(), method) << "Formal parameter " << f_name << " is multiply defined." << endl;
-    if (f_name == self)
+    if (symbol_flags.test(f_name, SYM_RESERVED))
       semant_error(c->get_filename(), method) << "'self' cannot be the name of a formal parameter." << endl;
-    if (f_type == SELF_TYPE)
+    if (symbol_flags.test(f_type, SYM_SELF_TYPE))
       semant_error(c->get_filename(), method) << "Formal parameter " << f_name << " cannot have type SELF_TYPE." << endl;
 
     formal_ids.insert(f_name);
@@ -827,19 +1182,34 @@ InheritanceNode::InheritanceNode(Symbol class_name, Class_ ref) : _ref(ref), _pa
 {
 }
 
-ClassTable::ClassTable(Classes classes) : semant_errors(0), error_stream(cerr)
+ClassTable::ClassTable(Classes classes) : error_stream(cerr), diagnostics(diagnostic_limit(0)), cut_short(false)
 {
-  _classes = append_Classes(install_basic_classes(), classes);
+  {
+    TimeSpan span("phase", "install_classes");
+    _classes = append_Classes(install_basic_classes(), classes);
+    install_classes();
+  }
 
-  install_classes();
-  build_inheritance();
+  {
+    TimeSpan span("phase", "build_inheritance");
+    build_inheritance();
+  }
   error_out();
 
-  cycle_check();
+  {
+    TimeSpan span("phase", "cycle_check");
+    cycle_check();
+  }
   error_out();
 
   main_req_check();
-  percolate_env(this->lookup(Object));
+
+  TimeSpan span("phase", "percolate_env");
+  for (int c = 0; c < N_BASIC_CLASSES; c++)
+    seed_basic_env(this->lookup(basic_symbols[basic_class_info[c].name]), basic_layouts[c]);
+
+  for (int c = 0; c < N_BASIC_CLASSES; c++)
+    percolate_env(this->lookup(basic_symbols[basic_class_info[c].name]));
 }
 
 Boolean InheritanceNode::is_ancestor(InheritanceNodeP i_node)
@@ -885,7 +1255,7 @@ void ClassTable::build_inheritance()
     if (parent == No_class)
       return;
 
-    if (uninheritable.count(parent->get_string()))
+    if (symbol_flags.test(parent, SYM_UNINHERITABLE))
     {
       semant_error(node->_ref) << "Class " << name << " cannot inherit class " << parent << "." << endl;
     }
@@ -910,9 +1280,9 @@ void ClassTable::install_classes()
     Class_ cur = _classes->nth(i);
     Symbol cur_name = cur->get_name();
 
-    if (this->probe(cur_name) || cur_name == SELF_TYPE)
+    if (this->probe(cur_name) || symbol_flags.test(cur_name, SYM_SELF_TYPE))
     {
-      if (basic_classes.count(cur_name->get_string()))
+      if (symbol_flags.test(cur_name, SYM_BASIC_CLASS))
       {
         semant_error(cur) << "Redefinition of basic class " << cur_name << "." << endl;
       }
@@ -931,70 +1301,12 @@ Classes ClassTable::install_basic_classes()
 {
   node_lineno = 0;
   Symbol filename = stringtable.add_string("<basic class>");
+  Classes classes = nil_Classes();
 
-  Class_ Object_class =
-      class_(Object,
-             No_class,
-             append_Features(
-                 append_Features(
-                     single_Features(method(cool_abort, nil_Formals(), Object, no_expr())),
-                     single_Features(method(type_name, nil_Formals(), Str, no_expr()))),
-                 single_Features(method(::copy, nil_Formals(), SELF_TYPE, no_expr()))),
-             filename);
-
-  Class_ IO_class =
-      class_(IO,
-             Object,
-             append_Features(
-                 append_Features(
-                     append_Features(
-                         single_Features(method(out_string, single_Formals(formal(arg, Str)),
-                                                SELF_TYPE, no_expr())),
-                         single_Features(method(out_int, single_Formals(formal(arg, Int)),
-                                                SELF_TYPE, no_expr()))),
-                     single_Features(method(in_string, nil_Formals(), Str, no_expr()))),
-                 single_Features(method(in_int, nil_Formals(), Int, no_expr()))),
-             filename);
-
-  Class_ Int_class =
-      class_(Int,
-             Object,
-             single_Features(attr(val, prim_slot, no_expr())),
-             filename);
-
-  Class_ Bool_class =
-      class_(Bool, Object, single_Features(attr(val, prim_slot, no_expr())), filename);
-
-  Class_ Str_class =
-      class_(Str,
-             Object,
-             append_Features(
-                 append_Features(
-                     append_Features(
-                         append_Features(
-                             single_Features(attr(val, Int, no_expr())),
-                             single_Features(attr(str_field, prim_slot, no_expr()))),
-                         single_Features(method(length, nil_Formals(), Int, no_expr()))),
-                     single_Features(method(concat,
-                                            single_Formals(formal(arg, Str)),
-                                            Str,
-                                            no_expr()))),
-                 single_Features(method(substr,
-                                        append_Formals(single_Formals(formal(arg, Int)),
-                                                       single_Formals(formal(arg2, Int))),
-                                        Str,
-                                        no_expr()))),
-             filename);
-
-  return append_Classes(
-      append_Classes(
-          append_Classes(
-              append_Classes(
-                  single_Classes(Object_class),
-                  single_Classes(IO_class)),
-              single_Classes(Int_class)),
-          single_Classes(Bool_class)),
-      single_Classes(Str_class));
+  for (const BasicClassInfo &info : basic_class_info)
+    classes = append_Classes(classes, single_Classes(basic_class(info, basic_symbols, filename)));
+
+  return classes;
 }
 
 ostream &ClassTable::semant_error(Class_ c)
@@ -1004,19 +1316,29 @@ ostream &ClassTable::semant_error(Class_ c)
 
 ostream &ClassTable::semant_error(Symbol filename, tree_node *t)
 {
-  error_stream << filename << ":" << t->get_line_number() << ": ";
-  return semant_error();
+  DiagnosticSink &sink = class_diagnostics ? *class_diagnostics : diagnostics;
+  return sink.report("semantic", filename->get_string(), t->get_line_number());
 }
 
 ostream &ClassTable::semant_error()
 {
-  semant_errors++;
-  return error_stream;
+  DiagnosticSink &sink = class_diagnostics ? *class_diagnostics : diagnostics;
+  return sink.report("semantic", "", 0);
+}
+
+//
+// Takes the diagnostics of the first count classes, in table order.
+//
+void ClassTable::merge_diagnostics(ClassDiagnosticsList &class_diags, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+    diagnostics.append(class_diags[i]);
 }
 
 void program_class::semant()
 {
   initialize_constants();
+  initialize_symbol_flags();
 
   ClassTableP classtable = new ClassTable(classes);
 
@@ -2,10 +2,14 @@
 #define SEMANT_H_
 
 #include <assert.h>
+#include <sstream>
 #include <vector>
 #include "cool-tree.h"
 #include "stringtab.h"
 #include "symtab.h"
+#include "scopetab.h"
+#include "diagnostics.h"
+#include "basic_classes.h"
 
 #define TRUE 1
 #define FALSE 0
@@ -18,11 +22,12 @@ typedef std::vector<InheritanceNodeP> InheritanceNodeList;
 typedef InheritanceNodeList *InheritanceNodeListP;
 typedef std::vector<Symbol> TypeList;
 typedef TypeList *TypeListP;
-typedef SymbolTable<Symbol, TypeList> MethodTable;
+typedef ScopedTable<Symbol, TypeList> MethodTable;
 typedef MethodTable *MethodTableP;
-typedef SymbolTable<Symbol, Entry> ObjectTable;
+typedef ScopedTable<Symbol, Entry> ObjectTable;
 typedef ObjectTable *ObjectTableP;
 typedef Symbol ClassName;
+typedef std::vector<DiagnosticSink> ClassDiagnosticsList;
 class Environment;
 typedef Environment *EnvironmentP;
 
@@ -52,7 +57,6 @@ public:
 class ClassTable : public SymbolTable<Symbol, InheritanceNode>
 {
 private:
-  int semant_errors;
   Classes _classes;
 
   Classes install_basic_classes();
@@ -63,6 +67,7 @@ private:
 
   MethodTableP clone_methods(MethodTableP);
   ObjectTableP clone_objects(ObjectTableP);
+  void seed_basic_env(InheritanceNodeP, const BasicLayout &);
   void percolate_env(InheritanceNodeP);
 
   void process_attr(InheritanceNodeP, Symbol, Feature);
@@ -74,15 +79,21 @@ private:
   void main_req_check();
 
   std::ostream &error_stream;
+  DiagnosticSink diagnostics;
+  Boolean cut_short; // the error limit left some classes unchecked
 
 public:
+  InheritanceNodeP lookup(Symbol);
   Boolean leq(Symbol, Symbol, Symbol);
   Symbol lub(Symbol, Symbol, Symbol);
 
   ClassTable(Classes);
 
-  int errors() { return semant_errors; }
+  int errors() { return diagnostics.size(); }
+  size_t error_limit() { return diagnostics.limit(); }
   void error_out();
+  void merge_diagnostics(ClassDiagnosticsList &, size_t);
+  void mark_cut_short() { cut_short = true; }
   std::ostream &semant_error();
   std::ostream &semant_error(Class_ c);
   std::ostream &semant_error(Symbol filename, tree_node *t);
@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include "semant.h"
+#include "semant_cache.h"
+
+#define CACHE_MAGIC "cool-semant-cache 2"
+
+//////////////////////////////////////////////////////////////////////
+//
+// AST flattening
+//
+// flatten() lists every expression of a subtree in a fixed pre-order, so
+// type annotations can be saved and put back without re-running
+// type_check.
+//
+//////////////////////////////////////////////////////////////////////
+
+static void flatten_list(Expressions ls, ExprList &out)
+{
+  for (int i = ls->first(); ls->more(i); i = ls->next(i))
+    ls->nth(i)->flatten(out);
+}
+
+void branch_class::flatten(ExprList &out) { expr->flatten(out); }
+
+void assign_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  expr->flatten(out);
+}
+
+void static_dispatch_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  expr->flatten(out);
+  flatten_list(actual, out);
+}
+
+void dispatch_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  expr->flatten(out);
+  flatten_list(actual, out);
+}
+
+void cond_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  pred->flatten(out);
+  then_exp->flatten(out);
+  else_exp->flatten(out);
+}
+
+void loop_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  pred->flatten(out);
+  body->flatten(out);
+}
+
+void typcase_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  expr->flatten(out);
+  for (int i = cases->first(); cases->more(i); i = cases->next(i))
+    cases->nth(i)->flatten(out);
+}
+
+void block_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  flatten_list(body, out);
+}
+
+void let_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  init->flatten(out);
+  body->flatten(out);
+}
+
+void plus_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  e1->flatten(out);
+  e2->flatten(out);
+}
+
+void sub_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  e1->flatten(out);
+  e2->flatten(out);
+}
+
+void mul_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  e1->flatten(out);
+  e2->flatten(out);
+}
+
+void divide_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  e1->flatten(out);
+  e2->flatten(out);
+}
+
+void neg_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  e1->flatten(out);
+}
+
+void lt_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  e1->flatten(out);
+  e2->flatten(out);
+}
+
+void eq_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  e1->flatten(out);
+  e2->flatten(out);
+}
+
+void leq_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  e1->flatten(out);
+  e2->flatten(out);
+}
+
+void comp_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  e1->flatten(out);
+}
+
+void int_const_class::flatten(ExprList &out) { out.push_back(this); }
+void bool_const_class::flatten(ExprList &out) { out.push_back(this); }
+void string_const_class::flatten(ExprList &out) { out.push_back(this); }
+void new__class::flatten(ExprList &out) { out.push_back(this); }
+
+void isvoid_class::flatten(ExprList &out)
+{
+  out.push_back(this);
+  e1->flatten(out);
+}
+
+void no_expr_class::flatten(ExprList &out) { out.push_back(this); }
+void object_class::flatten(ExprList &out) { out.push_back(this); }
+
+//////////////////////////////////////////////////////////////////////
+//
+// ClassCache
+//
+// The cache file is a magic line followed by one record per class.
+// Every string is written as "<length>:<bytes>" so diagnostics can
+// contain newlines.  Only the entries this run kept are written back, so
+// the keys of edited, renamed or deleted classes do not pile up.
+//
+//////////////////////////////////////////////////////////////////////
+
+std::string content_hash(const std::string &s)
+{
+  // 64-bit FNV-1a
+  unsigned long long h = 14695981039346656037ULL;
+  for (unsigned char c : s)
+  {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016llx", h);
+  return buf;
+}
+
+static void write_str(std::ostream &out, const std::string &s)
+{
+  out << s.size() << ':' << s;
+}
+
+static bool read_str(std::istream &in, std::string &s)
+{
+  size_t len;
+  char colon;
+  if (!(in >> len) || !in.get(colon) || colon != ':')
+    return false;
+
+  s.resize(len);
+  return len == 0 || in.read(&s[0], len);
+}
+
+static void write_list(std::ostream &out, const std::vector<std::string> &ls)
+{
+  out << ls.size() << ' ';
+  for (const std::string &s : ls)
+    write_str(out, s);
+}
+
+static bool read_list(std::istream &in, std::vector<std::string> &ls)
+{
+  size_t n;
+  if (!(in >> n))
+    return false;
+
+  ls.resize(n);
+  for (std::string &s : ls)
+    if (!read_str(in, s))
+      return false;
+  return true;
+}
+
+ClassCache::ClassCache(const char *path) : path(path), dirty(false)
+{
+  load();
+}
+
+void ClassCache::load()
+{
+  std::ifstream in(path, std::ios::binary);
+  std::string magic;
+  if (!std::getline(in, magic) || magic != CACHE_MAGIC)
+    return;
+
+  std::string key;
+  while (read_str(in, key))
+  {
+    ClassCacheEntry e;
+    if (!read_str(in, e.fingerprint) || !read_list(in, e.deps) || !read_list(in, e.types) ||
+        !read_list(in, e.diagnostics))
+    {
+      // A truncated or foreign file is only a cache miss.
+      entries.clear();
+      return;
+    }
+    entries[key] = e;
+  }
+}
+
+const ClassCacheEntry *ClassCache::find(const std::string &key) const
+{
+  auto it = entries.find(key);
+  return it == entries.end() ? NULL : &it->second;
+}
+
+void ClassCache::store(const std::string &key, const ClassCacheEntry &entry)
+{
+  entries[key] = entry;
+  live.insert(key);
+  dirty = true;
+}
+
+void ClassCache::keep(const std::string &key)
+{
+  live.insert(key);
+}
+
+void ClassCache::save()
+{
+  for (auto it = entries.begin(); it != entries.end();)
+  {
+    if (live.count(it->first))
+      ++it;
+    else
+    {
+      it = entries.erase(it);
+      dirty = true;
+    }
+  }
+
+  if (!dirty)
+    return;
+
+  std::ostringstream tmp_name;
+  tmp_name << path << ".tmp." << getpid();
+
+  {
+    std::ofstream out(tmp_name.str(), std::ios::binary | std::ios::trunc);
+    out << CACHE_MAGIC << '\n';
+
+    for (const auto &it : entries)
+    {
+      const ClassCacheEntry &e = it.second;
+      write_str(out, it.first);
+      write_str(out, e.fingerprint);
+      write_list(out, e.deps);
+      write_list(out, e.types);
+      write_list(out, e.diagnostics);
+      out << '\n';
+    }
+
+    if (!out)
+    {
+      unlink(tmp_name.str().c_str());
+      return;
+    }
+  }
+
+  // rename() is atomic, so a concurrent reader sees either the old file or
+  // the new one.
+  if (rename(tmp_name.str().c_str(), path.c_str()))
+    unlink(tmp_name.str().c_str());
+  dirty = false;
+}
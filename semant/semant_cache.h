@@ -0,0 +1,45 @@
+#ifndef SEMANT_CACHE_H_
+#define SEMANT_CACHE_H_
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+//
+// What type checking one class produced on a previous run.  deps names
+// every class the checker looked up, so the fingerprint can be recomputed
+// against the current program before the entry is trusted.  types holds
+// the class's expression annotations in flatten() order ("" for none).
+// diagnostics holds a (file, line, code, message) quadruple per error.
+//
+struct ClassCacheEntry
+{
+  std::string fingerprint;
+  std::vector<std::string> deps;
+  std::vector<std::string> types;
+  std::vector<std::string> diagnostics;
+};
+
+class ClassCache
+{
+private:
+  std::string path;
+  std::unordered_map<std::string, ClassCacheEntry> entries;
+  std::unordered_set<std::string> live;
+  bool dirty;
+
+  void load();
+
+public:
+  ClassCache(const char *path);
+
+  const ClassCacheEntry *find(const std::string &key) const;
+  void store(const std::string &key, const ClassCacheEntry &entry);
+  void keep(const std::string &key);
+  void save();
+};
+
+std::string content_hash(const std::string &);
+
+#endif